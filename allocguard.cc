@@ -0,0 +1,264 @@
+/**
+ * cpputil
+ *
+ * Allocation guard for real-time sections. This file replaces the
+ * global operator new/delete, and with UTILS_ALLOC_GUARD_MALLOC
+ * also interposes the glibc malloc family.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "allocguard.h"
+
+#include <execinfo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#if defined(UTILS_ALLOC_GUARD_MALLOC) && defined(__GLIBC__)
+#define UTILS_INTERPOSE_MALLOC 1
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+#define RAW_MALLOC __libc_malloc
+#else
+#define RAW_MALLOC malloc
+#endif
+
+namespace {
+
+// Per-thread guard state. It has to be constant-initialized with the
+// initial-exec TLS model: it is read from inside malloc, where a lazy
+// TLS allocation would recurse.
+struct GuardState {
+    int depth;
+    int mode;
+    int busy;
+    uint64_t count;
+};
+
+thread_local GuardState guard_state __attribute__((tls_model("initial-exec"))) =
+    {0, 0, 0, 0};
+
+// Call sites are kept in a fixed open-addressed table so recording one
+// never allocates.
+constexpr size_t kSiteSlots = 1024;
+
+struct SiteSlot {
+    std::atomic<uintptr_t> pc;
+    std::atomic<uint64_t> count;
+};
+
+SiteSlot site_table[kSiteSlots];
+std::atomic<uint64_t> violations{0};
+std::atomic<uint64_t> dropped_sites{0};
+
+void RecordSite(uintptr_t pc) {
+    size_t i = (pc >> 2) * 0x9E3779B97F4A7C15ull >> 54;  // 10 bits
+    for (size_t probe = 0; probe < kSiteSlots; probe++) {
+        SiteSlot& s = site_table[(i + probe) % kSiteSlots];
+        uintptr_t cur = s.pc.load(std::memory_order_acquire);
+        if (cur == 0 &&
+            s.pc.compare_exchange_strong(cur, pc, std::memory_order_acq_rel))
+            cur = pc;
+        if (cur == pc) {
+            s.count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    dropped_sites.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WriteStr(int fd, const char* s) {
+    ssize_t r = write(fd, s, strlen(s));
+    (void)r;
+}
+
+__attribute__((noinline)) void Violation(void* caller, size_t size) {
+    GuardState& g = guard_state;
+    g.count++;
+    violations.fetch_add(1, std::memory_order_relaxed);
+    if (g.busy) return;
+    g.busy = 1;
+    RecordSite((uintptr_t)caller);
+    if (g.mode == (int)Utils::AllocGuardMode::Trap) {
+        char buf[96];
+        snprintf(buf, sizeof(buf),
+                 "NoAllocScope: allocation of %zu bytes from ", size);
+        WriteStr(2, buf);
+        backtrace_symbols_fd(&caller, 1, 2);
+        abort();
+    }
+    g.busy = 0;
+}
+
+inline void Check(void* caller, size_t size) {
+    if (__builtin_expect(guard_state.depth != 0, 0)) Violation(caller, size);
+}
+
+void* NewImpl(size_t size, void* caller) {
+    Check(caller, size);
+    if (size == 0) size = 1;
+    for (;;) {
+        void* p = RAW_MALLOC(size);
+        if (p != nullptr) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* AlignedNewImpl(size_t size, size_t align, void* caller) {
+    Check(caller, size);
+    if (size == 0) size = 1;
+    for (;;) {
+        void* p = nullptr;
+        if (posix_memalign(&p, std::max(align, sizeof(void*)), size) == 0)
+            return p;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) throw std::bad_alloc();
+        handler();
+    }
+}
+
+}  // namespace
+
+Utils::NoAllocScope::NoAllocScope(AllocGuardMode mode)
+    : start_(guard_state.count), previous_mode_(guard_state.mode) {
+    guard_state.mode = std::max(guard_state.mode, (int)mode);
+    guard_state.depth++;
+}
+
+Utils::NoAllocScope::~NoAllocScope() {
+    guard_state.depth--;
+    guard_state.mode = previous_mode_;
+}
+
+uint64_t Utils::NoAllocScope::Allocations() const {
+    return guard_state.count - start_;
+}
+
+uint64_t Utils::AllocGuardViolations() {
+    return violations.load(std::memory_order_relaxed);
+}
+
+std::vector<Utils::AllocSite> Utils::AllocGuardSites() {
+    std::vector<AllocSite> sites;
+    for (auto& s : site_table) {
+        uintptr_t pc = s.pc.load(std::memory_order_acquire);
+        if (pc != 0)
+            sites.push_back({(void*)pc, s.count.load(std::memory_order_relaxed)});
+    }
+    std::sort(sites.begin(), sites.end(),
+              [](const AllocSite& a, const AllocSite& b) { return a.count > b.count; });
+    return sites;
+}
+
+/**
+ * @brief Writes every recorded allocation call site to a file descriptor.
+ *
+ * Symbols come from backtrace_symbols_fd, so the binary needs to be linked
+ * with -rdynamic for function names to show up. Sites are not sorted,
+ * because sorting would allocate.
+ *
+ * @param fd The file descriptor to write to.
+ */
+void Utils::AllocGuardReport(int fd) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "NoAllocScope: %llu allocations\n",
+             (unsigned long long)AllocGuardViolations());
+    WriteStr(fd, buf);
+    for (auto& s : site_table) {
+        uintptr_t pc = s.pc.load(std::memory_order_acquire);
+        if (pc == 0) continue;
+        snprintf(buf, sizeof(buf), "%10llu  ",
+                 (unsigned long long)s.count.load(std::memory_order_relaxed));
+        WriteStr(fd, buf);
+        void* addr = (void*)pc;
+        backtrace_symbols_fd(&addr, 1, fd);
+    }
+    uint64_t dropped = dropped_sites.load(std::memory_order_relaxed);
+    if (dropped > 0) {
+        snprintf(buf, sizeof(buf), "%10llu  from untracked sites\n",
+                 (unsigned long long)dropped);
+        WriteStr(fd, buf);
+    }
+}
+
+void Utils::AllocGuardReset() {
+    for (auto& s : site_table) {
+        s.count.store(0, std::memory_order_relaxed);
+        s.pc.store(0, std::memory_order_release);
+    }
+    violations.store(0, std::memory_order_relaxed);
+    dropped_sites.store(0, std::memory_order_relaxed);
+}
+
+// Replacement global allocation functions.
+
+void* operator new(size_t size) { return NewImpl(size, __builtin_return_address(0)); }
+void* operator new[](size_t size) { return NewImpl(size, __builtin_return_address(0)); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return NewImpl(size, __builtin_return_address(0));
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return NewImpl(size, __builtin_return_address(0));
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+    return AlignedNewImpl(size, (size_t)align, __builtin_return_address(0));
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+    return AlignedNewImpl(size, (size_t)align, __builtin_return_address(0));
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { free(p); }
+
+#ifdef UTILS_INTERPOSE_MALLOC
+extern "C" {
+
+void* malloc(size_t size) {
+    Check(__builtin_return_address(0), size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+    Check(__builtin_return_address(0), n * size);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    Check(__builtin_return_address(0), size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) { __libc_free(ptr); }
+
+}  // extern "C"
+#endif
@@ -0,0 +1,72 @@
+/**
+ * cpputil
+ *
+ * Allocation guard for real-time sections. Everything in the
+ * Fmt family allocates (_strfmt does a new char[] and returns a
+ * std::string), which is easy to forget inside a hard real-time
+ * loop. A NoAllocScope notices when that happens.
+ *
+ * Linking allocguard.cc replaces the global operator new and
+ * delete. Building it with UTILS_ALLOC_GUARD_MALLOC also
+ * interposes malloc, calloc, realloc and free (glibc only), so
+ * that C allocations are caught too.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_ALLOCGUARD_H__
+#define __UTILCPP_ALLOCGUARD_H__
+
+#include <stdint.h>
+#include <vector>
+
+namespace Utils {
+
+enum class AllocGuardMode {
+    Count,  // record the allocation and its call site, then carry on
+    Trap,   // print the call site and abort
+};
+
+// Marks the current thread as not allowed to allocate for the lifetime
+// of the object. Scopes nest; an inner Trap scope inside a Count scope
+// traps, an inner Count scope inside a Trap scope still traps. Outside
+// of a scope the hooks cost one thread-local load per allocation.
+class NoAllocScope {
+   public:
+    explicit NoAllocScope(AllocGuardMode mode = AllocGuardMode::Count);
+    ~NoAllocScope();
+
+    NoAllocScope(const NoAllocScope&) = delete;
+    NoAllocScope& operator=(const NoAllocScope&) = delete;
+
+    // Allocations made on this thread since the scope was entered.
+    uint64_t Allocations() const;
+
+   private:
+    uint64_t start_;
+    int previous_mode_;
+};
+
+// A place that allocated inside a NoAllocScope, identified by the
+// return address of the allocation call.
+struct AllocSite {
+    void* caller;
+    uint64_t count;
+};
+
+// Total allocations seen inside no-allocation scopes, on all threads.
+uint64_t AllocGuardViolations();
+
+// The call sites of those allocations, most frequent first.
+std::vector<AllocSite> AllocGuardSites();
+
+// Writes the call sites, symbolized where possible, to a file
+// descriptor. Does not allocate, so it is safe to call from anywhere.
+void AllocGuardReport(int fd = 2);
+
+// Forgets every recorded violation.
+void AllocGuardReset();
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_ALLOCGUARD_H__
@@ -0,0 +1,259 @@
+/**
+ * cpputil
+ *
+ * A small microbenchmark harness for the cpputil benchmarks: warmup,
+ * automatic batch sizing, repeated samples with summary statistics,
+ * optional CPU pinning, hardware counters and JSON output.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_BENCH_H__
+#define __UTILCPP_BENCH_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../perfcounters.h"
+#include "../profile.h"
+#include "../realtime.h"
+#include "../utils.h"
+
+namespace Bench {
+
+// Keeps the compiler from optimizing away a value or the work behind it.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template <typename T>
+inline void DoNotOptimize(T& value) {
+    asm volatile("" : "+r,m"(value) : : "memory");
+}
+
+inline void ClobberMemory() { asm volatile("" : : : "memory"); }
+
+struct Options {
+    std::string filter;       // only run benchmarks whose name contains this
+    std::string json_path;    // write results here as JSON if not empty
+    int cpu = -1;             // pin the benchmark thread to this CPU
+    int samples = 15;         // timed samples per benchmark
+    double min_sample_ms = 5; // each sample runs at least this long
+    double warmup_ms = 20;
+    bool counters = false;    // count hardware events for every group
+
+    // Parses --filter=, --json=, --cpu=, --samples=, --min-ms=, --warmup-ms=,
+    // --counters.
+    // Returns false (after printing usage) on anything else.
+    bool Parse(int argc, char** argv) {
+        for (int i = 1; i < argc; i++) {
+            std::string a = argv[i];
+            auto value = [&](const char* key) -> const char* {
+                size_t n = strlen(key);
+                return a.compare(0, n, key) == 0 ? argv[i] + n : nullptr;
+            };
+            if (const char* v = value("--filter=")) filter = v;
+            else if (const char* v = value("--json=")) json_path = v;
+            else if (const char* v = value("--cpu=")) cpu = atoi(v);
+            else if (const char* v = value("--samples=")) samples = std::max(3, atoi(v));
+            else if (const char* v = value("--min-ms=")) min_sample_ms = atof(v);
+            else if (const char* v = value("--warmup-ms=")) warmup_ms = atof(v);
+            else if (a == "--counters") counters = true;
+            else {
+                Utils::PrintLnFmt(
+                    "usage: %s [--filter=substr] [--json=file] [--cpu=n] [--samples=n] "
+                    "[--min-ms=ms] [--warmup-ms=ms] [--counters]",
+                    argv[0]);
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct Result {
+    std::string name;
+    std::string group;      // benchmarks in a group are compared to its first entry
+    int64_t size = 0;       // input size, 0 if not applicable
+    uint64_t batch = 0;     // operations per sample
+    double mean_ns = 0;     // per operation
+    double median_ns = 0;
+    double stddev_ns = 0;
+    double min_ns = 0;
+    double max_ns = 0;
+    double ci95_ns = 0;     // half width of the 95% confidence interval of the mean
+    bool counted = false;   // the fields below were measured
+    double ipc = 0;         // instructions per cycle
+    double cache_misses = 0;   // per operation
+    double branch_misses = 0;  // per operation
+};
+
+// Runs benchmarks and reports them. A benchmark is a function that
+// performs a given number of operations; the runner picks that number
+// so each sample lasts at least min_sample_ms. The "vs base" column is
+// the speedup of a row over the first row of the same group and size.
+// Groups chosen with CountGroup (or all of them, with --counters) also
+// get IPC and cache and branch misses per operation, measured over the
+// timed samples; the columns are left out when the kernel does not
+// permit hardware counters.
+class Runner {
+   public:
+    explicit Runner(const Options& options) : options_(options) {
+        if (options_.cpu >= 0) {
+            Utils::ThreadConfig cfg;
+            cfg.cpu = options_.cpu;
+            Utils::ThreadConfigResult r = Utils::ConfigureCurrentThread(cfg);
+            Utils::PrintLnFmt("# pinned: %s", r.Summary());
+        }
+    }
+
+    ~Runner() { WriteJson(); }
+
+    // Adds the counter columns to the rows of a group. Call it before
+    // the group's first Run.
+    void CountGroup(const std::string& group) { counted_groups_.push_back(group); }
+
+    void Run(const std::string& group, const std::string& name, int64_t size,
+             const std::function<void(uint64_t)>& body) {
+        std::string full = size ? Utils::StrFmt("%s/%s/%lld", group, name, (long long)size)
+                                : Utils::StrFmt("%s/%s", group, name);
+        if (!options_.filter.empty() && full.find(options_.filter) == std::string::npos) return;
+
+        // Warm up caches, branch predictors and the CPU clock, and find a
+        // batch size that makes a sample last at least min_sample_ms.
+        uint64_t batch = 1;
+        double warm_until = Utils::ProfileNow() + options_.warmup_ms * 1e6;
+        for (;;) {
+            double ns = Time(body, batch);
+            bool long_enough = ns >= options_.min_sample_ms * 1e6;
+            if (long_enough && Utils::ProfileNow() >= warm_until) break;
+            if (!long_enough)
+                batch = std::max<uint64_t>(batch * 2, (uint64_t)(batch * options_.min_sample_ms * 1.2e6 /
+                                                                 std::max(ns, 1.0)));
+        }
+
+        const bool count = Counting(group);
+        std::vector<double> per_op;
+        Utils::PerfSample events;
+        for (int s = 0; s < options_.samples; s++) {
+            Utils::PerfSample before = count ? counters_.Read() : Utils::PerfSample();
+            per_op.push_back(Time(body, batch) / batch);
+            if (count) events += counters_.Read() - before;
+        }
+        std::sort(per_op.begin(), per_op.end());
+
+        Result r;
+        r.name = name;
+        r.group = group;
+        r.size = size;
+        r.batch = batch;
+        r.min_ns = per_op.front();
+        r.max_ns = per_op.back();
+        r.median_ns = per_op[per_op.size() / 2];
+        for (double v : per_op) r.mean_ns += v;
+        r.mean_ns /= per_op.size();
+        for (double v : per_op) r.stddev_ns += (v - r.mean_ns) * (v - r.mean_ns);
+        r.stddev_ns = std::sqrt(r.stddev_ns / (per_op.size() - 1));
+        r.ci95_ns = 1.96 * r.stddev_ns / std::sqrt((double)per_op.size());
+        if (count) {
+            const double ops = (double)batch * options_.samples;
+            r.counted = true;
+            r.ipc = events.cycles ? (double)events.instructions / events.cycles : 0.0;
+            r.cache_misses = events.cache_misses / ops;
+            r.branch_misses = events.branch_misses / ops;
+        }
+
+        std::string vs = "";
+        for (const Result& base : results_) {
+            if (base.group == group && base.size == size) {
+                vs = Utils::StrFmt("%.2fx", base.median_ns / r.median_ns);
+                break;
+            }
+        }
+        PrintHeader();
+        std::string row = Utils::StrFmt("%-44s %10s %12.2f %12.2f %10.2f %10.2f %8s",
+                                        group + "/" + name,
+                                        size ? std::to_string(size) : std::string("-"),
+                                        r.median_ns, r.mean_ns, r.ci95_ns, r.min_ns, vs);
+        if (r.counted)
+            row += Utils::StrFmt(" %6.2f %10.3f %10.3f", r.ipc, r.cache_misses, r.branch_misses);
+        else if (ShowCounters())
+            row += Utils::StrFmt(" %6s %10s %10s", "-", "-", "-");
+        Utils::PrintLnFmt("%s", row);
+        results_.push_back(r);
+    }
+
+    const std::vector<Result>& Results() const { return results_; }
+
+   private:
+    bool ShowCounters() const {
+        return counters_.Available() && (options_.counters || !counted_groups_.empty());
+    }
+
+    bool Counting(const std::string& group) const {
+        return counters_.Available() &&
+               (options_.counters || std::find(counted_groups_.begin(), counted_groups_.end(),
+                                               group) != counted_groups_.end());
+    }
+
+    // Printed before the first row, once it is known whether any group
+    // is counted.
+    void PrintHeader() {
+        if (header_printed_) return;
+        header_printed_ = true;
+        std::string header =
+            Utils::StrFmt("%-44s %10s %12s %12s %10s %10s %8s", "benchmark", "size",
+                          "median ns", "mean ns", "+/- ns", "min ns", "vs base");
+        if (ShowCounters())
+            header += Utils::StrFmt(" %6s %10s %10s", "IPC", "miss/op", "brmiss/op");
+        else if (options_.counters || !counted_groups_.empty())
+            Utils::PrintLnFmt("# no hardware counters: %s", counters_.Error());
+        Utils::PrintLnFmt("%s", header);
+    }
+
+    static double Time(const std::function<void(uint64_t)>& body, uint64_t n) {
+        uint64_t start = Utils::ProfileNow();
+        body(n);
+        ClobberMemory();
+        return (double)(Utils::ProfileNow() - start);
+    }
+
+    void WriteJson() const {
+        if (options_.json_path.empty()) return;
+        std::ofstream out(options_.json_path);
+        out << "{\"benchmarks\":[";
+        for (size_t i = 0; i < results_.size(); i++) {
+            const Result& r = results_[i];
+            std::string obj = Utils::StrFmt(
+                "{\"group\":\"%s\",\"name\":\"%s\",\"size\":%lld,\"batch\":%llu,"
+                "\"median_ns\":%.3f,\"mean_ns\":%.3f,\"stddev_ns\":%.3f,"
+                "\"ci95_ns\":%.3f,\"min_ns\":%.3f,\"max_ns\":%.3f",
+                r.group, r.name, (long long)r.size, (unsigned long long)r.batch, r.median_ns,
+                r.mean_ns, r.stddev_ns, r.ci95_ns, r.min_ns, r.max_ns);
+            if (r.counted)
+                obj += Utils::StrFmt(",\"ipc\":%.3f,\"cache_misses\":%.4f,\"branch_misses\":%.4f",
+                                     r.ipc, r.cache_misses, r.branch_misses);
+            out << (i ? ",\n" : "\n") << obj << "}";
+        }
+        out << "\n]}\n";
+        Utils::PrintLnFmt("# wrote %zu results to %s", results_.size(), options_.json_path);
+    }
+
+    Options options_;
+    std::vector<Result> results_;
+    Utils::PerfCounters& counters_ = Utils::ThreadPerfCounters();
+    std::vector<std::string> counted_groups_;
+    bool header_printed_ = false;
+};
+
+};  // namespace Bench
+
+#endif  // __UTILCPP_BENCH_H__
@@ -0,0 +1,406 @@
+/**
+ * cpputil
+ *
+ * Throughput and correctness harness for the buffer codecs. Generates
+ * telemetry frames the way our loops produce them (noisy sensors,
+ * counters and flag words), then for every codec measures encode and
+ * decode speed, the encoded size, and checks that what comes back is
+ * exactly what the scalar BufAppend/BufRead reference produces. New
+ * codecs go in kCodecs below.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include <math.h>
+
+#include <random>
+
+#include "bench.h"
+
+namespace {
+
+enum class Kind { kSensor16, kSensor32, kCounter, kFlags };
+
+struct Channel {
+    Kind kind;
+    float scale;  // sensors only
+};
+
+// Frames of samples, row major: values[frame * channels.size() + c].
+// Sensors hold floats, counters and flags hold integers.
+struct Telemetry {
+    std::string mix;
+    std::vector<Channel> channels;
+    size_t frames = 0;
+    std::vector<double> values;
+
+    size_t Values() const { return values.size(); }
+    // What the samples take as plain 32-bit values; throughput and ratios
+    // are relative to this.
+    size_t RawBytes() const { return Values() * 4; }
+};
+
+// Generates a mix of sensors16 16-bit sensors, sensors32 32-bit sensors,
+// counters and flag words. Sensors are slow sines plus gaussian noise,
+// counters advance by small random steps, and each flag bit toggles
+// rarely.
+Telemetry Generate(const std::string& mix, int sensors16, int sensors32, int counters,
+                   int flags, size_t frames) {
+    Telemetry t;
+    t.mix = mix;
+    t.frames = frames;
+    for (int i = 0; i < sensors16; i++) t.channels.push_back({Kind::kSensor16, 100.0f});
+    for (int i = 0; i < sensors32; i++) t.channels.push_back({Kind::kSensor32, 10000.0f});
+    for (int i = 0; i < counters; i++) t.channels.push_back({Kind::kCounter, 1.0f});
+    for (int i = 0; i < flags; i++) t.channels.push_back({Kind::kFlags, 1.0f});
+
+    std::mt19937_64 rng(42);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::uniform_int_distribution<int> step(0, 20);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::vector<double> state(t.channels.size(), 0.0);
+    t.values.resize(frames * t.channels.size());
+    for (size_t f = 0; f < frames; f++) {
+        for (size_t c = 0; c < t.channels.size(); c++) {
+            double& v = t.values[f * t.channels.size() + c];
+            switch (t.channels[c].kind) {
+                case Kind::kSensor16:
+                    v = (float)(50.0 * sin(f * 0.01 + c) + 0.5 * noise(rng));
+                    break;
+                case Kind::kSensor32:
+                    v = (float)(1000.0 * sin(f * 0.001 + c) + 0.01 * noise(rng));
+                    break;
+                case Kind::kCounter:
+                    v = state[c] += step(rng);
+                    break;
+                case Kind::kFlags: {
+                    int bits = (int)state[c];
+                    for (int b = 0; b < 16; b++)
+                        if (coin(rng) < 0.002) bits ^= 1 << b;
+                    v = state[c] = (int16_t)bits;
+                    break;
+                }
+            }
+        }
+    }
+    return t;
+}
+
+// A codec turns a block of telemetry into bytes and back. Decoding only
+// needs the channel layout and frame count, which a real receiver knows
+// from the schema.
+struct Codec {
+    const char* name;
+    // Returns the number of bytes written. out has MaxEncodedSize() bytes.
+    size_t (*encode)(const Telemetry& t, uint8_t* out);
+    void (*decode)(const Telemetry& t, const uint8_t* in, size_t size, double* out);
+};
+
+size_t MaxEncodedSize(const Telemetry& t) { return t.Values() * 5 + 16; }
+
+// The reference: BufAppend/BufRead one value at a time.
+size_t EncodeScalar(const Telemetry& t, uint8_t* out) {
+    int32_t index = 0;
+    const size_t n = t.channels.size();
+    for (size_t f = 0; f < t.frames; f++) {
+        for (size_t c = 0; c < n; c++) {
+            double v = t.values[f * n + c];
+            switch (t.channels[c].kind) {
+                case Kind::kSensor16:
+                    Utils::BufAppendFloat16(out, (float)v, t.channels[c].scale, &index);
+                    break;
+                case Kind::kSensor32:
+                    Utils::BufAppendFloat32(out, (float)v, t.channels[c].scale, &index);
+                    break;
+                case Kind::kCounter:
+                    Utils::BufAppendInt32(out, (int32_t)v, &index);
+                    break;
+                case Kind::kFlags:
+                    Utils::BufAppendInt16(out, (int16_t)v, &index);
+                    break;
+            }
+        }
+    }
+    return index;
+}
+
+void DecodeScalar(const Telemetry& t, const uint8_t* in, size_t, double* out) {
+    int32_t index = 0;
+    const size_t n = t.channels.size();
+    for (size_t f = 0; f < t.frames; f++) {
+        for (size_t c = 0; c < n; c++) {
+            double& v = out[f * n + c];
+            switch (t.channels[c].kind) {
+                case Kind::kSensor16:
+                    v = Utils::BufReadFloat16(in, t.channels[c].scale, &index);
+                    break;
+                case Kind::kSensor32:
+                    v = Utils::BufReadFloat32(in, t.channels[c].scale, &index);
+                    break;
+                case Kind::kCounter:
+                    v = Utils::BufReadInt32(in, &index);
+                    break;
+                case Kind::kFlags:
+                    v = Utils::BufReadInt16(in, &index);
+                    break;
+            }
+        }
+    }
+}
+
+// The value a channel puts on the wire, before byte order.
+inline int32_t Quantize(const Channel& ch, double v) {
+    switch (ch.kind) {
+        case Kind::kSensor16:
+            return (int16_t)((float)v * ch.scale);
+        case Kind::kSensor32:
+            return (int32_t)((float)v * ch.scale);
+        case Kind::kCounter:
+            return (int32_t)v;
+        case Kind::kFlags:
+            return (int16_t)v;
+    }
+    return 0;
+}
+
+inline double Dequantize(const Channel& ch, int32_t q) {
+    switch (ch.kind) {
+        case Kind::kSensor16:
+        case Kind::kSensor32:
+            return q / ch.scale;
+        default:
+            return q;
+    }
+}
+
+inline bool Wide(Kind k) { return k == Kind::kSensor32 || k == Kind::kCounter; }
+
+// The reference wire format, written with whole-word byte swaps instead of
+// a byte at a time.
+size_t EncodeBswap(const Telemetry& t, uint8_t* out) {
+    uint8_t* p = out;
+    const size_t n = t.channels.size();
+    for (size_t f = 0; f < t.frames; f++) {
+        const double* row = &t.values[f * n];
+        for (size_t c = 0; c < n; c++) {
+            int32_t q = Quantize(t.channels[c], row[c]);
+            if (Wide(t.channels[c].kind)) {
+                uint32_t be = __builtin_bswap32((uint32_t)q);
+                memcpy(p, &be, 4);
+                p += 4;
+            } else {
+                uint16_t be = __builtin_bswap16((uint16_t)q);
+                memcpy(p, &be, 2);
+                p += 2;
+            }
+        }
+    }
+    return p - out;
+}
+
+void DecodeBswap(const Telemetry& t, const uint8_t* in, size_t, double* out) {
+    const uint8_t* p = in;
+    const size_t n = t.channels.size();
+    for (size_t f = 0; f < t.frames; f++) {
+        double* row = &out[f * n];
+        for (size_t c = 0; c < n; c++) {
+            int32_t q;
+            if (Wide(t.channels[c].kind)) {
+                uint32_t be;
+                memcpy(&be, p, 4);
+                q = (int32_t)__builtin_bswap32(be);
+                p += 4;
+            } else {
+                uint16_t be;
+                memcpy(&be, p, 2);
+                q = (int16_t)__builtin_bswap16(be);
+                p += 2;
+            }
+            row[c] = Dequantize(t.channels[c], q);
+        }
+    }
+}
+
+// Each channel's change since the previous frame, zigzag encoded as a
+// LEB128 varint. Quantization is the reference's, so it is lossless
+// relative to it, and slowly changing channels shrink to a byte or two.
+size_t EncodeDeltaVarint(const Telemetry& t, uint8_t* out) {
+    uint8_t* p = out;
+    const size_t n = t.channels.size();
+    std::vector<int32_t> prev(n, 0);
+    for (size_t f = 0; f < t.frames; f++) {
+        const double* row = &t.values[f * n];
+        for (size_t c = 0; c < n; c++) {
+            int32_t q = Quantize(t.channels[c], row[c]);
+            uint32_t d = (uint32_t)q - (uint32_t)prev[c];
+            uint32_t z = (d << 1) ^ (uint32_t)((int32_t)d >> 31);
+            prev[c] = q;
+            while (z >= 0x80) {
+                *p++ = (uint8_t)(z | 0x80);
+                z >>= 7;
+            }
+            *p++ = (uint8_t)z;
+        }
+    }
+    return p - out;
+}
+
+void DecodeDeltaVarint(const Telemetry& t, const uint8_t* in, size_t, double* out) {
+    const uint8_t* p = in;
+    const size_t n = t.channels.size();
+    std::vector<int32_t> prev(n, 0);
+    for (size_t f = 0; f < t.frames; f++) {
+        double* row = &out[f * n];
+        for (size_t c = 0; c < n; c++) {
+            uint32_t z = 0;
+            for (int shift = 0;; shift += 7) {
+                uint8_t b = *p++;
+                z |= (uint32_t)(b & 0x7f) << shift;
+                if (b < 0x80) break;
+            }
+            uint32_t d = (z >> 1) ^ (0u - (z & 1));
+            prev[c] = (int32_t)((uint32_t)prev[c] + d);
+            row[c] = Dequantize(t.channels[c], prev[c]);
+        }
+    }
+}
+
+// The first entry is the reference every other codec is checked against.
+const Codec kCodecs[] = {
+    {"scalar", EncodeScalar, DecodeScalar},
+    {"bswap", EncodeBswap, DecodeBswap},
+    {"delta-varint", EncodeDeltaVarint, DecodeDeltaVarint},
+};
+
+// Round trip checks. The reference itself must come back within one
+// quantization step of the source; every other codec must decode to
+// exactly what the reference decodes to. Returns the number of failures.
+int Check(const Telemetry& t) {
+    int failures = 0;
+    const Codec& ref = kCodecs[0];
+    std::vector<uint8_t> ref_buf(MaxEncodedSize(t));
+    size_t ref_size = ref.encode(t, ref_buf.data());
+    std::vector<double> expected(t.Values());
+    ref.decode(t, ref_buf.data(), ref_size, expected.data());
+
+    double max_err[4] = {0, 0, 0, 0};
+    for (size_t i = 0; i < t.Values(); i++) {
+        const Channel& ch = t.channels[i % t.channels.size()];
+        double err = fabs(expected[i] - t.values[i]);
+        double& worst = max_err[(int)ch.kind];
+        worst = std::max(worst, err);
+        // Truncation loses up to one step; float rounding of the product
+        // adds a little on top.
+        if (err > 1.0001 / ch.scale) {
+            if (failures++ < 5)
+                Utils::PrintLnFmt("FAIL %s/%s: value %zu is %.9g, decoded %.9g", t.mix, ref.name,
+                                  i, t.values[i], expected[i]);
+        }
+    }
+    Utils::PrintLnFmt("# %s: %s max error sensor16 %.3g sensor32 %.3g counter %g flags %g", t.mix,
+                      ref.name, max_err[0], max_err[1], max_err[2], max_err[3]);
+
+    for (const Codec& codec : kCodecs) {
+        if (&codec == &ref) continue;
+        std::vector<uint8_t> buf(MaxEncodedSize(t));
+        size_t size = codec.encode(t, buf.data());
+        std::vector<double> got(t.Values(), NAN);
+        codec.decode(t, buf.data(), size, got.data());
+        size_t mismatches = 0;
+        for (size_t i = 0; i < t.Values(); i++)
+            if (memcmp(&got[i], &expected[i], sizeof(double)) != 0) mismatches++;
+        if (mismatches) {
+            failures++;
+            Utils::PrintLnFmt("FAIL %s/%s: %zu of %zu values differ from %s", t.mix, codec.name,
+                              mismatches, t.Values(), ref.name);
+        }
+    }
+    return failures;
+}
+
+struct Throughput {
+    std::string mix;
+    std::string codec;
+    double encode_gbs = 0;
+    double decode_gbs = 0;
+    double bytes_per_frame = 0;
+    double ratio = 0;  // raw bytes / encoded bytes
+};
+
+// The median time per block of the benchmark just run, or 0 if the
+// filter skipped it.
+double LastMedian(const Bench::Runner& run, size_t before) {
+    return run.Results().size() > before ? run.Results().back().median_ns : 0;
+}
+
+// Returns false if the filter skipped both directions.
+bool Measure(Bench::Runner& run, const Telemetry& t, const Codec& codec, Throughput* r) {
+    std::vector<uint8_t> buf(MaxEncodedSize(t));
+    std::vector<double> out(t.Values());
+    size_t size = codec.encode(t, buf.data());
+
+    size_t before = run.Results().size();
+    run.Run("encode/" + t.mix, codec.name, t.frames, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            size_t s = codec.encode(t, buf.data());
+            Bench::DoNotOptimize(s);
+            Bench::ClobberMemory();
+        }
+    });
+    double encode_ns = LastMedian(run, before);
+
+    before = run.Results().size();
+    run.Run("decode/" + t.mix, codec.name, t.frames, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            codec.decode(t, buf.data(), size, out.data());
+            Bench::ClobberMemory();
+        }
+    });
+    double decode_ns = LastMedian(run, before);
+
+    r->mix = t.mix;
+    r->codec = codec.name;
+    r->encode_gbs = encode_ns > 0 ? t.RawBytes() / encode_ns : 0;
+    r->decode_gbs = decode_ns > 0 ? t.RawBytes() / decode_ns : 0;
+    r->bytes_per_frame = (double)size / t.frames;
+    r->ratio = (double)t.RawBytes() / size;
+    return encode_ns > 0 || decode_ns > 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Bench::Options options;
+    if (!options.Parse(argc, argv)) return 2;
+
+    const size_t frames = 4096;
+    std::vector<Telemetry> mixes = {
+        Generate("mixed", 24, 8, 16, 16, frames),
+        Generate("sensors", 48, 16, 0, 0, frames),
+        Generate("counters", 0, 0, 64, 0, frames),
+        Generate("flags", 0, 0, 0, 64, frames),
+    };
+
+    int failures = 0;
+    for (const Telemetry& t : mixes) failures += Check(t);
+
+    std::vector<Throughput> results;
+    {
+        Bench::Runner run(options);
+        for (const Telemetry& t : mixes) {
+            for (const Codec& codec : kCodecs) {
+                Throughput r;
+                if (Measure(run, t, codec, &r)) results.push_back(r);
+            }
+        }
+    }
+
+    Utils::PrintLnFmt("\n%-10s %-14s %12s %12s %12s %8s", "mix", "codec", "encode GB/s",
+                      "decode GB/s", "bytes/frame", "ratio");
+    for (const Throughput& r : results)
+        Utils::PrintLnFmt("%-10s %-14s %12.2f %12.2f %12.1f %7.2fx", r.mix, r.codec, r.encode_gbs,
+                          r.decode_gbs, r.bytes_per_frame, r.ratio);
+
+    if (failures) Utils::PrintLnFmt("%d round trip check(s) failed", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,546 @@
+/**
+ * cpputil
+ *
+ * Microbenchmarks for every facility in utils.h, with std
+ * alternatives alongside for comparison. Run with --help for the
+ * options; --json= writes the results for later comparison.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <unordered_map>
+
+#if __has_include(<format>)
+#include <format>
+#endif
+
+#include "../concurrentmap.h"
+#include "../configparse.h"
+#include "../eytzinger.h"
+#include "../flatmap.h"
+#include "../hashmap.h"
+#include "../parallel.h"
+#include "../perfecthash.h"
+#include "bench.h"
+
+namespace {
+
+// Swallows everything written to it, so LogFmt can be timed without the
+// terminal getting in the way.
+class NullBuffer : public std::streambuf {
+   protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+void BenchFormatting(Bench::Runner& run) {
+    const std::string name = "telemetry.channel";
+    for (int len : {8, 64, 512}) {
+        std::string arg(len, 'x');
+        run.Run("format", "StrFmt", len, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                std::string s = Utils::StrFmt("%s=%d (%.3f) %s", name, (int)i, i * 0.5, arg);
+                Bench::DoNotOptimize(s);
+            }
+        });
+        run.Run("format", "snprintf", len, [&](uint64_t n) {
+            char buf[1024];
+            for (uint64_t i = 0; i < n; i++) {
+                int k = snprintf(buf, sizeof(buf), "%s=%d (%.3f) %s", name.c_str(), (int)i,
+                                 i * 0.5, arg.c_str());
+                Bench::DoNotOptimize(k);
+                Bench::ClobberMemory();
+            }
+        });
+        run.Run("format", "ostringstream", len, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                std::ostringstream os;
+                os.precision(3);
+                os << name << "=" << (int)i << " (" << std::fixed << i * 0.5 << ") " << arg;
+                std::string s = os.str();
+                Bench::DoNotOptimize(s);
+            }
+        });
+#if defined(__cpp_lib_format)
+        run.Run("format", "std::format", len, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                std::string s = std::format("{}={} ({:.3f}) {}", name, (int)i, i * 0.5, arg);
+                Bench::DoNotOptimize(s);
+            }
+        });
+#endif
+    }
+
+    NullBuffer null_buffer;
+    std::streambuf* saved = std::cout.rdbuf(&null_buffer);
+    run.Run("format", "LogFmt", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) Utils::LogFmt("%s=%d", name, (int)i);
+    });
+    run.Run("format", "PrintLnFmt", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) Utils::PrintLnFmt("%s=%d", name, (int)i);
+    });
+    std::cout.rdbuf(saved);
+}
+
+void BenchBuffers(Bench::Runner& run) {
+    for (int count : {16, 256, 4096}) {
+        std::vector<uint8_t> buf(count * 4);
+        std::vector<float> values(count);
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+        for (auto& v : values) v = dist(rng);
+
+        run.Run("buffer", "BufAppendInt16", count, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                int32_t index = 0;
+                for (int k = 0; k < count; k++) Utils::BufAppendInt16(buf.data(), (int16_t)k, &index);
+                Bench::ClobberMemory();
+            }
+        });
+        run.Run("buffer", "BufAppendInt32", count, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                int32_t index = 0;
+                for (int k = 0; k < count; k++) Utils::BufAppendInt32(buf.data(), k, &index);
+                Bench::ClobberMemory();
+            }
+        });
+        run.Run("buffer", "BufAppendFloat16", count, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                int32_t index = 0;
+                for (int k = 0; k < count; k++)
+                    Utils::BufAppendFloat16(buf.data(), values[k], 100.0f, &index);
+                Bench::ClobberMemory();
+            }
+        });
+        run.Run("buffer", "BufAppendFloat32", count, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                int32_t index = 0;
+                for (int k = 0; k < count; k++)
+                    Utils::BufAppendFloat32(buf.data(), values[k], 1000.0f, &index);
+                Bench::ClobberMemory();
+            }
+        });
+        run.Run("buffer", "memcpy float", count, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                memcpy(buf.data(), values.data(), count * sizeof(float));
+                Bench::ClobberMemory();
+            }
+        });
+    }
+}
+
+void BenchTime(Bench::Runner& run) {
+    run.Run("time", "CurrentDateTimeStr", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            std::string s = Utils::CurrentDateTimeStr();
+            Bench::DoNotOptimize(s);
+        }
+    });
+    run.Run("time", "PreciseTime<us>", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            auto t = Utils::PreciseTime<int64_t, Utils::t_us>();
+            Bench::DoNotOptimize(t);
+        }
+    });
+    run.Run("time", "steady_clock::now", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            auto t = std::chrono::steady_clock::now();
+            Bench::DoNotOptimize(t);
+        }
+    });
+
+    // Already overdue, so ScheduleRate returns without sleeping and only
+    // its own bookkeeping is measured.
+    auto past = Utils::Now() - std::chrono::seconds(1);
+    run.Run("time", "ScheduleRate overdue", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            double dt = Utils::ScheduleRate(100, past);
+            Bench::DoNotOptimize(dt);
+        }
+    });
+    Utils::VirtualClock virtual_clock;
+    {
+        Utils::ScopedClockSource scoped(&virtual_clock);
+        run.Run("time", "ScheduleRate virtual", 0, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                double dt = Utils::ScheduleRate(1000, Utils::Now());
+                Bench::DoNotOptimize(dt);
+            }
+        });
+    }
+}
+
+void BenchAngles(Bench::Runner& run) {
+    std::vector<double> angles(1024);
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<double> dist(-20.0, 20.0);
+    for (auto& a : angles) a = dist(rng);
+
+    run.Run("angle", "NormalizeAnglePositive", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            double a = Utils::NormalizeAnglePositive(angles[i & 1023]);
+            Bench::DoNotOptimize(a);
+        }
+    });
+    run.Run("angle", "NormalizeAngle", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            double a = Utils::NormalizeAngle(angles[i & 1023]);
+            Bench::DoNotOptimize(a);
+        }
+    });
+    run.Run("angle", "remainder", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            double a = std::remainder(angles[i & 1023], 2.0 * M_PI);
+            Bench::DoNotOptimize(a);
+        }
+    });
+    run.Run("angle", "ShortestAngularDistance", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            double a = Utils::ShortestAngularDistance(angles[i & 1023], angles[(i + 1) & 1023]);
+            Bench::DoNotOptimize(a);
+        }
+    });
+    run.Run("angle", "Clamp", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            double a = Utils::Clamp(angles[i & 1023], 3.0, -3.0);
+            Bench::DoNotOptimize(a);
+        }
+    });
+}
+
+void BenchContainers(Bench::Runner& run) {
+    for (int size : {16, 1024, 65536}) {
+        std::vector<int32_t> v(size);
+        for (int i = 0; i < size; i++) v[i] = i * 3;
+        const int32_t last = v.back();  // worst case: found at the end
+
+        run.Run("search", "std::find", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                auto it = std::find(v.begin(), v.end(), last);
+                Bench::DoNotOptimize(it);
+            }
+        });
+        run.Run("search", "VecIndexOf", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                long idx = Utils::VecIndexOf(v, last);
+                Bench::DoNotOptimize(idx);
+            }
+        });
+        run.Run("search", "VecContains", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                bool found = Utils::VecContains(v, last);
+                Bench::DoNotOptimize(found);
+            }
+        });
+    }
+
+    // Multi-million-element scans, where the parallel search takes over.
+    for (int size : {1 << 20, 16 << 20}) {
+        std::vector<int32_t> v(size);
+        for (int i = 0; i < size; i++) v[i] = i * 3;
+        const int32_t last = v.back();
+
+        run.Run("psearch", "VecIndexOf", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                long idx = Utils::VecIndexOf(v, last);
+                Bench::DoNotOptimize(idx);
+            }
+        });
+        run.Run("psearch", "ParallelIndexOf", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                long idx = Utils::ParallelIndexOf(v, last);
+                Bench::DoNotOptimize(idx);
+            }
+        });
+        run.Run("psearch", "ParallelCount", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                size_t c = Utils::ParallelCount(v, last);
+                Bench::DoNotOptimize(c);
+            }
+        });
+    }
+
+    // Static lookup tables: binary search against the Eytzinger layout,
+    // with random queries so the larger sizes miss the cache. The miss
+    // counts show how much of the difference is the layout.
+    run.CountGroup("sorted");
+    for (int size : {1024, 1 << 20, 16 << 20}) {
+        std::vector<uint32_t> v(size);
+        for (int i = 0; i < size; i++) v[i] = (uint32_t)i * 3;
+        std::vector<uint32_t> sorted = v;
+        Utils::EytzingerIndex<uint32_t> index(v);
+        std::mt19937 rng(7);
+        std::vector<uint32_t> queries(4096);
+        for (auto& q : queries) q = v[rng() % size];
+
+        run.Run("sorted", "std::lower_bound", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                auto it = std::lower_bound(sorted.begin(), sorted.end(), queries[i & 4095]);
+                Bench::DoNotOptimize(it);
+            }
+        });
+        run.Run("sorted", "EytzingerIndex", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                long idx = index.IndexOf(queries[i & 4095]);
+                Bench::DoNotOptimize(idx);
+            }
+        });
+    }
+
+    for (int size : {16, 1024, 16384}) {
+        std::map<std::string, int> m;
+        std::vector<std::string> keys;
+        for (int i = 0; i < size; i++) {
+            keys.push_back(Utils::StrFmt("param.%06d", i));
+            m[keys.back()] = i;
+        }
+        run.Run("map", "MapGetOrDefault", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                int x = Utils::MapGetOrDefault(m, keys[i % size], -1);
+                Bench::DoNotOptimize(x);
+            }
+        });
+        run.Run("map", "std::map::find", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                auto it = m.find(keys[i % size]);
+                int x = it == m.end() ? -1 : it->second;
+                Bench::DoNotOptimize(x);
+            }
+        });
+        Utils::FlatMap<std::string, int> flat(m.begin(), m.end());
+        run.Run("map", "FlatMap::find", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                auto it = flat.find(keys[i % size]);
+                int x = it == flat.end() ? -1 : it->second;
+                Bench::DoNotOptimize(x);
+            }
+        });
+
+        run.Run("map-iterate", "std::map", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                int sum = 0;
+                for (const auto& kv : m) sum += kv.second;
+                Bench::DoNotOptimize(sum);
+            }
+        });
+        run.Run("map-iterate", "FlatMap", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                int sum = 0;
+                for (int v : flat.values()) sum += v;
+                Bench::DoNotOptimize(sum);
+            }
+        });
+    }
+
+    // Channel ID to state lookups, in random order.
+    for (int size : {1024, 65536, 1 << 20}) {
+        std::mt19937 rng(13);
+        std::vector<uint32_t> ids(size);
+        for (auto& id : ids) id = (uint32_t)rng();
+        std::map<uint32_t, uint64_t> tree;
+        std::unordered_map<uint32_t, uint64_t> std_hash;
+        Utils::HashMap<uint32_t, uint64_t> swiss;
+        for (int i = 0; i < size; i++) {
+            tree[ids[i]] = i;
+            std_hash[ids[i]] = i;
+            swiss[ids[i]] = i;
+        }
+        Utils::FlatMap<uint32_t, uint64_t> flat(tree.begin(), tree.end());
+        std::vector<uint32_t> queries(4096);
+        for (auto& q : queries) q = ids[rng() % size];
+
+        run.Run("hash", "std::map", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                uint64_t x = Utils::MapGetOrDefault(tree, queries[i & 4095], 0);
+                Bench::DoNotOptimize(x);
+            }
+        });
+        run.Run("hash", "std::unordered_map", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                uint64_t x = Utils::MapGetOrDefault(std_hash, queries[i & 4095], 0);
+                Bench::DoNotOptimize(x);
+            }
+        });
+        run.Run("hash", "FlatMap", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                uint64_t x = Utils::MapGetOrDefault(flat, queries[i & 4095], 0);
+                Bench::DoNotOptimize(x);
+            }
+        });
+        run.Run("hash", "HashMap", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                uint64_t x = Utils::MapGetOrDefault(swiss, queries[i & 4095], 0);
+                Bench::DoNotOptimize(x);
+            }
+        });
+        run.Run("hash-miss", "std::unordered_map", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                uint64_t x = Utils::MapGetOrDefault(std_hash, queries[i & 4095] ^ 1, 0);
+                Bench::DoNotOptimize(x);
+            }
+        });
+        run.Run("hash-miss", "HashMap", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                uint64_t x = Utils::MapGetOrDefault(swiss, queries[i & 4095] ^ 1, 0);
+                Bench::DoNotOptimize(x);
+            }
+        });
+        run.Run("hash-build", "std::unordered_map", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                std::unordered_map<uint32_t, uint64_t> m;
+                for (int k = 0; k < size; k++) m[ids[k]] = k;
+                Bench::DoNotOptimize(m);
+            }
+        });
+        run.Run("hash-build", "HashMap", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                Utils::HashMap<uint32_t, uint64_t> m;
+                for (int k = 0; k < size; k++) m[ids[k]] = k;
+                Bench::DoNotOptimize(m);
+            }
+        });
+
+        // Lookups in a table shared between threads, uncontended: the
+        // cost of the lock versus the cost of the epoch guard.
+        std::mutex mutex;
+        Utils::ConcurrentMap<uint32_t, uint64_t> shared(size);
+        for (int i = 0; i < size; i++) shared.Set(ids[i], i);
+        run.Run("shared-read", "mutex+unordered_map", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                std::lock_guard<std::mutex> lock(mutex);
+                uint64_t x = Utils::MapGetOrDefault(std_hash, queries[i & 4095], 0);
+                Bench::DoNotOptimize(x);
+            }
+        });
+        run.Run("shared-read", "ConcurrentMap", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                uint64_t x = shared.GetOrDefault(queries[i & 4095], 0);
+                Bench::DoNotOptimize(x);
+            }
+        });
+    }
+}
+
+// Command names known at compile time, looked up by name as a command
+// parser would.
+constexpr auto kCommands = Utils::MakePerfectHashMap<std::string_view, int>({
+    {"start", 0},     {"stop", 1},       {"status", 2},    {"reset", 3},
+    {"arm", 4},       {"disarm", 5},     {"calibrate", 6}, {"zero", 7},
+    {"set_rate", 8},  {"get_rate", 9},   {"set_gain", 10}, {"get_gain", 11},
+    {"telemetry", 12}, {"heartbeat", 13}, {"version", 14},  {"shutdown", 15},
+});
+
+void BenchConstLookup(Bench::Runner& run) {
+    std::map<std::string, int> tree;
+    std::unordered_map<std::string, int> std_hash;
+    Utils::HashMap<std::string, int> swiss;
+    std::vector<std::string> names;
+    for (const auto& e : kCommands) {
+        tree.emplace(e.first, e.second);
+        std_hash.emplace(e.first, e.second);
+        swiss[std::string(e.first)] = e.second;
+        names.emplace_back(e.first);
+    }
+    std::mt19937 rng(17);
+    std::vector<std::string_view> queries(4096);
+    for (auto& q : queries) q = names[rng() % names.size()];
+
+    run.Run("const-lookup", "std::map", kCommands.size(), [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            int x = Utils::MapGetOrDefault(tree, queries[i & 4095], -1);
+            Bench::DoNotOptimize(x);
+        }
+    });
+    run.Run("const-lookup", "std::unordered_map", kCommands.size(), [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            int x = Utils::MapGetOrDefault(std_hash, queries[i & 4095], -1);
+            Bench::DoNotOptimize(x);
+        }
+    });
+    run.Run("const-lookup", "HashMap", kCommands.size(), [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            int x = Utils::MapGetOrDefault(swiss, queries[i & 4095], -1);
+            Bench::DoNotOptimize(x);
+        }
+    });
+    run.Run("const-lookup", "PerfectHashMap", kCommands.size(), [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            int x = Utils::MapGetOrDefault(kCommands, queries[i & 4095], -1);
+            Bench::DoNotOptimize(x);
+        }
+    });
+}
+
+// Loading a parameter file at startup: getline into a std::map of
+// strings, as the callers used to, against ConfigFile.
+void BenchConfig(Bench::Runner& run) {
+    for (int size : {1000, 100000}) {
+        std::string path = (std::filesystem::temp_directory_path() /
+                            Utils::StrFmt("cpputil_bench_%d.ini", size))
+                               .string();
+        {
+            std::ofstream file(path);
+            for (int i = 0; i < size; i++) {
+                if (i % 100 == 0) file << "[section" << i / 100 << "]\n";
+                file << "parameter_" << i << " = " << i * 0.001 << "\n";
+            }
+        }
+
+        run.Run("config-load", "getline+std::map", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                std::ifstream file(path);
+                std::map<std::string, std::string> values;
+                std::string line, section;
+                while (std::getline(file, line)) {
+                    if (line.empty()) continue;
+                    if (line[0] == '[') {
+                        section = line.substr(1, line.find(']') - 1);
+                        continue;
+                    }
+                    size_t eq = line.find('=');
+                    values[section + "." + line.substr(0, eq - 1)] = line.substr(eq + 2);
+                }
+                Bench::DoNotOptimize(values);
+            }
+        });
+        run.Run("config-load", "ConfigFile::Open", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                Utils::ConfigFile file;
+                file.Open(path);
+                Bench::DoNotOptimize(file);
+            }
+        });
+        run.Run("config-load", "ConfigFile::Read", size, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                Utils::ConfigFile file;
+                file.Read(path);
+                Bench::DoNotOptimize(file);
+            }
+        });
+        std::filesystem::remove(path);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Bench::Options options;
+    if (!options.Parse(argc, argv)) return 2;
+    Bench::Runner run(options);
+    BenchFormatting(run);
+    BenchBuffers(run);
+    BenchTime(run);
+    BenchAngles(run);
+    BenchContainers(run);
+    BenchConstLookup(run);
+    BenchConfig(run);
+    return 0;
+}
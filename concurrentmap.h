@@ -0,0 +1,245 @@
+/**
+ * cpputil
+ *
+ * A hash map for tables that many threads read and few write. Readers
+ * take no lock and write no shared memory: a lookup is an EpochGuard
+ * and a walk down one bucket's chain, so read throughput grows with
+ * the number of cores. Nodes are immutable; a writer replaces or
+ * unlinks a node under the lock of the bucket's stripe and retires the
+ * old one through epoch.h. Growing the table takes every stripe, builds
+ * a new table beside the old one and swaps it in with one store.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_CONCURRENTMAP_H__
+#define __UTILCPP_CONCURRENTMAP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include "epoch.h"
+#include "hashmap.h"
+
+namespace Utils {
+
+template <typename K, typename V, typename HashFn = Hash, typename Eq = std::equal_to<>>
+class ConcurrentMap {
+   public:
+    explicit ConcurrentMap(size_t capacity = 64, HashFn hash = HashFn(), Eq eq = Eq())
+        : hash_(hash), eq_(eq) {
+        size_t buckets = kStripes;
+        while (buckets < capacity) buckets *= 2;
+        table_.store(new Table(buckets), std::memory_order_relaxed);
+    }
+
+    // Destroying the map while other threads still use it is an error,
+    // so everything is freed immediately.
+    ~ConcurrentMap() { DeleteTable(table_.load(std::memory_order_relaxed)); }
+
+    ConcurrentMap(const ConcurrentMap&) = delete;
+    ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+
+    size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+    // Calls f with the value for key, inside the read guard, and returns
+    // whether the key was found. Nothing is copied; f must not keep the
+    // reference.
+    template <typename Q, typename F>
+    bool Visit(const Q& key, F&& f) const {
+        EpochGuard guard;
+        if (const Node* n = FindNode(key, hash_(key))) {
+            f(n->value);
+            return true;
+        }
+        return false;
+    }
+
+    template <typename Q>
+    bool Contains(const Q& key) const {
+        EpochGuard guard;
+        return FindNode(key, hash_(key)) != nullptr;
+    }
+
+    template <typename Q>
+    std::optional<V> Get(const Q& key) const {
+        EpochGuard guard;
+        if (const Node* n = FindNode(key, hash_(key))) return n->value;
+        return std::nullopt;
+    }
+
+    template <typename Q>
+    V GetOrDefault(const Q& key, const V& default_val) const {
+        EpochGuard guard;
+        const Node* n = FindNode(key, hash_(key));
+        return n ? n->value : default_val;
+    }
+
+    // Inserts or replaces. Returns true if the key was new.
+    bool Set(const K& key, V value) { return Write(key, std::move(value), true); }
+
+    // Inserts only if the key is absent. Returns true if it was.
+    bool Insert(const K& key, V value) { return Write(key, std::move(value), false); }
+
+    template <typename Q>
+    bool Erase(const Q& key) {
+        const size_t hash = hash_(key);
+        Node* removed = nullptr;
+        {
+            StripeLock lock(this, hash);
+            std::atomic<Node*>* link = &lock.table->Bucket(hash);
+            for (Node* n = link->load(std::memory_order_relaxed); n;
+                 link = &n->next, n = n->next.load(std::memory_order_relaxed)) {
+                if (n->hash == hash && eq_(n->key, key)) {
+                    link->store(n->next.load(std::memory_order_relaxed),
+                                std::memory_order_release);
+                    removed = n;
+                    break;
+                }
+            }
+        }
+        if (removed == nullptr) return false;
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        EpochRetire(removed);
+        return true;
+    }
+
+   private:
+    // Writers to different stripes proceed in parallel.
+    static constexpr size_t kStripes = 64;
+
+    struct Node {
+        Node(size_t h, const K& k, V v, Node* n) : hash(h), key(k), value(std::move(v)), next(n) {}
+
+        const size_t hash;
+        const K key;
+        const V value;
+        std::atomic<Node*> next;
+    };
+
+    struct Table {
+        explicit Table(size_t n) : mask(n - 1), buckets(new std::atomic<Node*>[n]) {
+            for (size_t i = 0; i < n; i++) buckets[i].store(nullptr, std::memory_order_relaxed);
+        }
+        std::atomic<Node*>& Bucket(size_t hash) { return buckets[hash & mask]; }
+
+        const size_t mask;
+        std::unique_ptr<std::atomic<Node*>[]> buckets;
+    };
+
+    struct alignas(64) Stripe {
+        std::mutex mutex;
+    };
+
+    // Locks the stripe that owns hash. The bucket count is a multiple of
+    // kStripes, so a bucket belongs to the same stripe in every table, and
+    // since growing takes every stripe, the table loaded under the lock
+    // stays current until it is released.
+    struct StripeLock {
+        StripeLock(ConcurrentMap* map, size_t hash)
+            : lock(map->stripes_[hash % kStripes].mutex) {
+            table = map->table_.load(std::memory_order_acquire);
+        }
+        std::unique_lock<std::mutex> lock;
+        Table* table;
+    };
+
+    template <typename Q>
+    const Node* FindNode(const Q& key, size_t hash) const {
+        Table* t = table_.load(std::memory_order_acquire);
+        for (const Node* n = t->Bucket(hash).load(std::memory_order_acquire); n;
+             n = n->next.load(std::memory_order_acquire))
+            if (n->hash == hash && eq_(n->key, key)) return n;
+        return nullptr;
+    }
+
+    // Old nodes and tables are retired only once the stripe locks are
+    // released, since retiring may run deleters that are due.
+    bool Write(const K& key, V value, bool replace) {
+        const size_t hash = hash_(key);
+        Node* replaced = nullptr;
+        {
+            StripeLock lock(this, hash);
+            std::atomic<Node*>& head = lock.table->Bucket(hash);
+            std::atomic<Node*>* link = &head;
+            for (Node* n = link->load(std::memory_order_relaxed); n;
+                 link = &n->next, n = n->next.load(std::memory_order_relaxed)) {
+                if (n->hash != hash || !eq_(n->key, key)) continue;
+                if (!replace) return false;
+                // Readers at n keep following n->next, which still leads
+                // to the rest of the chain.
+                Node* fresh = new Node(hash, key, std::move(value),
+                                       n->next.load(std::memory_order_relaxed));
+                link->store(fresh, std::memory_order_release);
+                replaced = n;
+                break;
+            }
+            if (replaced == nullptr)
+                head.store(
+                    new Node(hash, key, std::move(value), head.load(std::memory_order_relaxed)),
+                    std::memory_order_release);
+        }
+        if (replaced != nullptr) {
+            EpochRetire(replaced);
+            return false;
+        }
+        if (size_.fetch_add(1, std::memory_order_relaxed) + 1 > Capacity()) Grow();
+        return true;
+    }
+
+    size_t Capacity() const { return table_.load(std::memory_order_relaxed)->mask + 1; }
+
+    // Doubles the bucket count once there is more than one key per
+    // bucket. Readers keep using the old table and its nodes until they
+    // leave their guards, so the new table gets copies.
+    void Grow() {
+        Table* old;
+        {
+            std::unique_lock<std::mutex> locks[kStripes];
+            for (size_t i = 0; i < kStripes; i++)
+                locks[i] = std::unique_lock<std::mutex>(stripes_[i].mutex);
+            old = table_.load(std::memory_order_relaxed);
+            if (size_.load(std::memory_order_relaxed) <= old->mask + 1) return;
+
+            Table* grown = new Table(2 * (old->mask + 1));
+            for (size_t b = 0; b <= old->mask; b++) {
+                for (Node* n = old->buckets[b].load(std::memory_order_relaxed); n;
+                     n = n->next.load(std::memory_order_relaxed)) {
+                    std::atomic<Node*>& head = grown->Bucket(n->hash);
+                    head.store(
+                        new Node(n->hash, n->key, n->value, head.load(std::memory_order_relaxed)),
+                        std::memory_order_relaxed);
+                }
+            }
+            table_.store(grown, std::memory_order_release);
+        }
+        EpochRetire(old, [](void* p) { DeleteTable(static_cast<Table*>(p)); });
+    }
+
+    static void DeleteTable(Table* t) {
+        for (size_t b = 0; b <= t->mask; b++) {
+            for (Node* n = t->buckets[b].load(std::memory_order_relaxed); n;) {
+                Node* next = n->next.load(std::memory_order_relaxed);
+                delete n;
+                n = next;
+            }
+        }
+        delete t;
+    }
+
+    std::atomic<Table*> table_;
+    std::atomic<size_t> size_{0};
+    Stripe stripes_[kStripes];
+    HashFn hash_;
+    Eq eq_;
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_CONCURRENTMAP_H__
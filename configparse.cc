@@ -0,0 +1,311 @@
+/**
+ * cpputil
+ *
+ * A parser for INI-like parameter files.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "configparse.h"
+
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <vector>
+
+#include "utils.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define UTILS_CONFIG_MMAP 1
+#endif
+
+namespace {
+
+bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+std::string_view Trim(const char* begin, const char* end) {
+    while (begin < end && IsBlank(*begin)) begin++;
+    while (end > begin && IsBlank(end[-1])) end--;
+    return std::string_view(begin, end - begin);
+}
+
+// Calls f(begin, end, eq) for each line of text, where eq is the first
+// "=" in the line or nullptr. Newlines and "=" are found a register at a
+// time; the bytes in between are never looked at here.
+template <typename F>
+void ForEachLine(const char* text, size_t size, F&& f) {
+    const char* line = text;
+    const char* eq = nullptr;
+    size_t i = 0;
+#if defined(UTILS_SIMD_AVX2) || defined(UTILS_SIMD_SSE2)
+    using Eq = Utils::_simd_eq<char>;
+    const auto newline = Eq::Splat('\n');
+    const auto equals = Eq::Splat('=');
+    for (; i + Utils::_simd::kBytes <= size; i += Utils::_simd::kBytes) {
+        auto block = Utils::_simd::Load(text + i);
+        uint32_t mask =
+            Utils::_simd::Mask(Utils::_simd::Or(Eq::Eq(block, newline), Eq::Eq(block, equals)));
+        for (; mask; mask &= mask - 1) {
+            const char* c = text + i + __builtin_ctz(mask);
+            if (*c == '\n') {
+                f(line, c, eq);
+                line = c + 1;
+                eq = nullptr;
+            } else if (eq == nullptr) {
+                eq = c;
+            }
+        }
+    }
+#endif
+    for (; i < size; i++) {
+        const char* c = text + i;
+        if (*c == '\n') {
+            f(line, c, eq);
+            line = c + 1;
+            eq = nullptr;
+        } else if (*c == '=' && eq == nullptr) {
+            eq = c;
+        }
+    }
+    if (line < text + size) f(line, text + size, eq);
+}
+
+struct Entry {
+    std::string_view section;
+    std::string_view key;
+    std::string_view value;
+};
+
+}  // namespace
+
+Utils::ConfigFile::~ConfigFile() { Release(); }
+
+Utils::ConfigFile::ConfigFile(ConfigFile&& o) noexcept
+    : data_(o.data_),
+      size_(o.size_),
+      mapped_(o.mapped_),
+      owned_(std::move(o.owned_)),
+      sections_(std::move(o.sections_)) {
+    o.data_ = nullptr;
+    o.size_ = 0;
+    o.mapped_ = false;
+}
+
+Utils::ConfigFile& Utils::ConfigFile::operator=(ConfigFile&& o) noexcept {
+    if (this != &o) {
+        Release();
+        data_ = o.data_;
+        size_ = o.size_;
+        mapped_ = o.mapped_;
+        owned_ = std::move(o.owned_);
+        sections_ = std::move(o.sections_);
+        o.data_ = nullptr;
+        o.size_ = 0;
+        o.mapped_ = false;
+    }
+    return *this;
+}
+
+void Utils::ConfigFile::Release() {
+    sections_.clear();
+#ifdef UTILS_CONFIG_MMAP
+    if (mapped_) munmap(const_cast<char*>(data_), size_);
+#endif
+    owned_.reset();
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+}
+
+/**
+ * @brief Maps a file into memory and parses it in place.
+ *
+ * @param path The file.
+ *
+ * @return false if the file cannot be opened or mapped.
+ */
+bool Utils::ConfigFile::Open(const std::string& path) {
+#ifdef UTILS_CONFIG_MMAP
+    Release();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return false;
+    }
+    if (st.st_size > 0) {
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(p);
+        size_ = (size_t)st.st_size;
+        mapped_ = true;
+    }
+    close(fd);
+    ParseBuffer(path);
+    return true;
+#else
+    return Read(path);
+#endif
+}
+
+bool Utils::ConfigFile::Read(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    std::streamoff end = file.tellg();
+    if (end < 0) return false;  // not seekable, e.g. a pipe
+    auto size = (size_t)end;
+    std::unique_ptr<char[]> buffer(new char[size]);
+    file.seekg(0);
+    if (!file.read(buffer.get(), (std::streamsize)size)) return false;
+    Release();
+    owned_ = std::move(buffer);
+    data_ = owned_.get();
+    size_ = size;
+    ParseBuffer(path);
+    return true;
+}
+
+void Utils::ConfigFile::Parse(std::string_view text) {
+    Release();
+    owned_.reset(new char[text.size()]);
+    memcpy(owned_.get(), text.data(), text.size());
+    data_ = owned_.get();
+    size_ = text.size();
+    ParseBuffer("<text>");
+}
+
+/**
+ * @brief Splits the buffer into sections of key/value views. Entries are
+ * collected in one vector, and each section's run of them is handed to
+ * its FlatMap's batch insert, newest first so that the last value of a
+ * repeated key wins.
+ */
+void Utils::ConfigFile::ParseBuffer(const std::string& name) {
+    // Counting lines first is far cheaper than growing the vector.
+    std::vector<Entry> entries;
+    entries.reserve(CountEqual(data_, size_, '\n') + 1);
+    std::vector<std::string_view> headers;
+    std::string_view section;
+    int number = 0;
+    ForEachLine(data_, size_, [&](const char* begin, const char* end, const char* eq) {
+        number++;
+        std::string_view line = Trim(begin, end);
+        if (line.empty() || line[0] == '#' || line[0] == ';') return;
+        if (line[0] == '[') {
+            size_t close = line.find(']');
+            if (close == std::string_view::npos) {
+                LogFmt("config: %s:%d: unterminated section header", name, number);
+                return;
+            }
+            section = Trim(line.data() + 1, line.data() + close);
+            headers.push_back(section);
+            return;
+        }
+        if (eq == nullptr) {
+            LogFmt("config: %s:%d: expected key = value", name, number);
+            return;
+        }
+        entries.push_back({section, Trim(begin, eq), Trim(eq + 1, end)});
+    });
+
+    // Entries arrive grouped by header. Only a section that is opened
+    // twice needs them regrouped.
+    if (!entries.empty() && entries[0].section.empty()) headers.push_back("");
+    std::sort(headers.begin(), headers.end());
+    if (std::adjacent_find(headers.begin(), headers.end()) != headers.end())
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](const Entry& a, const Entry& b) { return a.section < b.section; });
+    std::vector<std::pair<std::string_view, ConfigSection>> sections;
+    std::vector<std::pair<std::string_view, std::string_view>> pairs;
+    for (auto group = entries.begin(); group != entries.end();) {
+        auto next = std::find_if(group, entries.end(),
+                                 [&](const Entry& e) { return e.section != group->section; });
+        pairs.clear();
+        for (auto it = next; it != group;) {
+            --it;
+            pairs.emplace_back(it->key, it->value);
+        }
+        sections.emplace_back(group->section, ConfigSection(pairs.begin(), pairs.end()));
+        group = next;
+    }
+    // Headers with no keys still name a section.
+    headers.erase(std::unique(headers.begin(), headers.end()), headers.end());
+    for (std::string_view h : headers) sections.emplace_back(h, ConfigSection());
+    sections_.insert(std::make_move_iterator(sections.begin()),
+                     std::make_move_iterator(sections.end()));
+}
+
+const Utils::ConfigSection* Utils::ConfigFile::Section(std::string_view name) const {
+    auto it = sections_.find(name);
+    return it == sections_.end() ? nullptr : &it->second;
+}
+
+std::optional<std::string_view> Utils::ConfigFile::Find(std::string_view section,
+                                                        std::string_view key) const {
+    const ConfigSection* s = Section(section);
+    if (s == nullptr) return std::nullopt;
+    return MapGet(*s, key);
+}
+
+size_t Utils::ConfigFile::Size() const {
+    size_t n = 0;
+    for (const auto& s : sections_.values()) n += s.size();
+    return n;
+}
+
+bool Utils::ConfigParseInt(std::string_view s, int64_t* out) {
+    const char* p = s.data();
+    const char* end = p + s.size();
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    int base = 10;
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        base = 16;
+        p += 2;
+    }
+    uint64_t u;
+    auto [ptr, ec] = std::from_chars(p, end, u, base);
+    if (ec != std::errc() || ptr != end) return false;
+    if (u > (uint64_t)INT64_MAX + (negative ? 1 : 0)) return false;
+    *out = negative ? (int64_t)(0 - u) : (int64_t)u;
+    return true;
+}
+
+bool Utils::ConfigParseDouble(std::string_view s, double* out) {
+    const char* p = s.data();
+    const char* end = p + s.size();
+    // from_chars takes a "-" but not a "+", so only one sign may come
+    // before the digits.
+    if (p < end && *p == '+' && ++p < end && *p == '-') return false;
+    double v;
+    auto [ptr, ec] = std::from_chars(p, end, v);
+    if (ec != std::errc() || ptr != end) return false;
+    *out = v;
+    return true;
+}
+
+bool Utils::ConfigParseBool(std::string_view s, bool* out) {
+    auto is = [&](const char* word) {
+        return s.size() == strlen(word) && strncasecmp(s.data(), word, s.size()) == 0;
+    };
+    if (is("true") || is("yes") || is("on") || is("1")) {
+        *out = true;
+        return true;
+    }
+    if (is("false") || is("no") || is("off") || is("0")) {
+        *out = false;
+        return true;
+    }
+    return false;
+}
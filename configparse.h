@@ -0,0 +1,88 @@
+/**
+ * cpputil
+ *
+ * A parser for INI-like parameter files that does no work per entry
+ * beyond finding it. The file is mapped (or read in one go), lines and
+ * "=" are located with SIMD compares, and each section becomes a
+ * FlatMap of string_views pointing into the file's bytes, so a large
+ * file loads with a handful of allocations in total. Sections work
+ * with MapGetOrDefault and the other map helpers directly.
+ *
+ * Format: "key = value" lines, "#" or ";" comment lines, "[section]"
+ * headers. Surrounding blanks are trimmed. Keys before the first header
+ * are in the section named "". A key given twice keeps its last value.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_CONFIGPARSE_H__
+#define __UTILCPP_CONFIGPARSE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "flatmap.h"
+
+namespace Utils {
+
+using ConfigSection = FlatMap<std::string_view, std::string_view>;
+
+class ConfigFile {
+   public:
+    ConfigFile() = default;
+    ~ConfigFile();
+
+    ConfigFile(ConfigFile&& o) noexcept;
+    ConfigFile& operator=(ConfigFile&& o) noexcept;
+    ConfigFile(const ConfigFile&) = delete;
+    ConfigFile& operator=(const ConfigFile&) = delete;
+
+    // Maps the file and parses it. The mapping is private, but a file
+    // that is truncated while mapped makes later reads fault, so only
+    // map files that are replaced rather than rewritten in place.
+    bool Open(const std::string& path);
+
+    // Reads the file into one buffer owned by this object and parses
+    // it. Safe against any later change to the file.
+    bool Read(const std::string& path);
+
+    // Copies text into an owned buffer and parses it.
+    void Parse(std::string_view text);
+
+    // The section, or nullptr. The top of the file is section "".
+    const ConfigSection* Section(std::string_view name) const;
+    // Iterate with const auto& (not auto&, see flatmap.h).
+    const FlatMap<std::string_view, ConfigSection>& Sections() const { return sections_; }
+
+    std::optional<std::string_view> Find(std::string_view section, std::string_view key) const;
+
+    // Number of key/value pairs over all sections.
+    size_t Size() const;
+
+   private:
+    void Release();
+    // name is used in messages about malformed lines.
+    void ParseBuffer(const std::string& name);
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::unique_ptr<char[]> owned_;
+    FlatMap<std::string_view, ConfigSection> sections_;
+};
+
+// Value parsers for config strings, built on std::from_chars. Integers
+// may be negative and may be written in hex with a 0x prefix. Booleans
+// are true/false, yes/no, on/off or 1/0 in any case. Each returns false,
+// leaving out untouched, unless the whole string is a valid value.
+bool ConfigParseInt(std::string_view s, int64_t* out);
+bool ConfigParseDouble(std::string_view s, double* out);
+bool ConfigParseBool(std::string_view s, bool* out);
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_CONFIGPARSE_H__
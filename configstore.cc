@@ -0,0 +1,180 @@
+/**
+ * cpputil
+ *
+ * A parameter store with hot reload.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "configstore.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "utils.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Looks up a flattened key. The whole key is tried in the top
+ * section first, then split at each "." in turn, so section names and
+ * keys may themselves contain dots.
+ */
+std::optional<std::string_view> Utils::ConfigSnapshot::Find(std::string_view key) const {
+    if (auto value = file.Find("", key)) return value;
+    for (size_t dot = key.find('.'); dot != std::string_view::npos; dot = key.find('.', dot + 1))
+        if (auto value = file.Find(key.substr(0, dot), key.substr(dot + 1))) return value;
+    return std::nullopt;
+}
+
+std::string Utils::ConfigSnapshot::GetString(std::string_view key,
+                                             const std::string& default_val) const {
+    auto value = Find(key);
+    return value ? std::string(*value) : default_val;
+}
+
+int64_t Utils::ConfigSnapshot::GetInt(std::string_view key, int64_t default_val) const {
+    auto value = Find(key);
+    int64_t v;
+    return value && ConfigParseInt(*value, &v) ? v : default_val;
+}
+
+double Utils::ConfigSnapshot::GetDouble(std::string_view key, double default_val) const {
+    auto value = Find(key);
+    double v;
+    return value && ConfigParseDouble(*value, &v) ? v : default_val;
+}
+
+bool Utils::ConfigSnapshot::GetBool(std::string_view key, bool default_val) const {
+    auto value = Find(key);
+    bool v;
+    return value && ConfigParseBool(*value, &v) ? v : default_val;
+}
+
+Utils::ConfigStore::ConfigStore(const std::string& path, ReloadCallback on_reload)
+    : path_(path), on_reload_(std::move(on_reload)), current_(new ConfigSnapshot()) {}
+
+Utils::ConfigStore::~ConfigStore() {
+    Stop();
+    delete current_.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Reads the file into a new snapshot and publishes it.
+ *
+ * The file is parsed without touching the current snapshot, so readers
+ * are never blocked and never see a partly loaded configuration.
+ *
+ * @return false if the file could not be read, in which case the
+ * current snapshot stays in place.
+ */
+bool Utils::ConfigStore::Load() {
+    std::lock_guard<std::mutex> lock(load_mutex_);
+    // Read rather than mapped: the snapshot outlives the file version it
+    // came from, and a mapping would fault if the file were truncated.
+    auto* next = new ConfigSnapshot();
+    if (!next->file.Read(path_)) {
+        LogFmt("config: cannot read %s", path_);
+        delete next;
+        return false;
+    }
+    next->version = next_version_++;
+    Publish(next);
+    return true;
+}
+
+void Utils::ConfigStore::Publish(ConfigSnapshot* next) {
+    const ConfigSnapshot* old = current_.exchange(next, std::memory_order_acq_rel);
+    EpochRetire(const_cast<ConfigSnapshot*>(old));
+}
+
+#ifdef __linux__
+
+bool Utils::ConfigStore::Watch() {
+    if (thread_.joinable()) return true;
+
+    // Watch the directory rather than the file, so that replacing the
+    // file (write to a temporary, rename over) is seen as well.
+    std::filesystem::path file(path_);
+    std::string dir = file.has_parent_path() ? file.parent_path().string() : ".";
+    inotify_fd_ = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (inotify_fd_ < 0) {
+        LogFmt("config: inotify_init1 failed: %s", strerror(errno));
+        return false;
+    }
+    if (inotify_add_watch(inotify_fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) <
+        0) {
+        LogFmt("config: cannot watch %s: %s", dir, strerror(errno));
+        close(inotify_fd_);
+        inotify_fd_ = -1;
+        return false;
+    }
+    stop_fd_ = eventfd(0, EFD_CLOEXEC);
+    if (stop_fd_ < 0) {
+        // Without it Stop() could not wake the thread to join it.
+        LogFmt("config: eventfd failed: %s", strerror(errno));
+        close(inotify_fd_);
+        inotify_fd_ = -1;
+        return false;
+    }
+    thread_ = std::thread(&ConfigStore::WatchLoop, this);
+    return true;
+}
+
+void Utils::ConfigStore::Stop() {
+    if (!thread_.joinable()) return;
+    uint64_t one = 1;
+    if (write(stop_fd_, &one, sizeof(one)) < 0) LogFmt("config: cannot stop watcher");
+    thread_.join();
+    close(inotify_fd_);
+    close(stop_fd_);
+    inotify_fd_ = stop_fd_ = -1;
+}
+
+/**
+ * @brief The watcher thread. Waits for events on the file's directory
+ * and reloads once the file has been quiet for a moment, so that a
+ * burst of writes from one save causes one reload.
+ */
+void Utils::ConfigStore::WatchLoop() {
+    const std::string name = std::filesystem::path(path_).filename().string();
+    alignas(inotify_event) char buf[4096];
+    bool changed = false;
+    while (true) {
+        pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+        int n = poll(fds, 2, changed ? 50 : -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LogFmt("config: poll failed: %s", strerror(errno));
+            return;
+        }
+        if (fds[1].revents) return;
+        if (n == 0) {
+            changed = false;
+            if (Load() && on_reload_) on_reload_(*Read());
+            continue;
+        }
+
+        ssize_t len;
+        while ((len = read(inotify_fd_, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + len;) {
+                auto* event = reinterpret_cast<inotify_event*>(p);
+                if (event->len > 0 && name == event->name) changed = true;
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+    }
+}
+
+#else
+
+bool Utils::ConfigStore::Watch() { return false; }
+void Utils::ConfigStore::Stop() {}
+void Utils::ConfigStore::WatchLoop() {}
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * cpputil
+ *
+ * A parameter store that can be changed without a restart. The file is
+ * parsed into an immutable snapshot of its sections and values, and
+ * published through one atomic pointer. A background thread watches the
+ * file with inotify, builds the next snapshot off the hot path and swaps
+ * it in; the old one is freed through epoch.h once no reader can still
+ * be using it. Readers take no lock: acquiring a snapshot is an
+ * EpochGuard and one atomic load.
+ *
+ * The file is parsed by ConfigFile (configparse.h). Lookups here take
+ * flattened keys: "section.key" for a key under a "[section]" header.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_CONFIGSTORE_H__
+#define __UTILCPP_CONFIGSTORE_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "configparse.h"
+#include "epoch.h"
+
+namespace Utils {
+
+// One version of the parameters. Never modified once published, so it
+// can be read from any number of threads.
+struct ConfigSnapshot {
+    ConfigFile file;
+    uint64_t version = 0;
+
+    // The value of "key" in the top section, or of "section.key". Views
+    // point into the snapshot.
+    std::optional<std::string_view> Find(std::string_view key) const;
+
+    // Typed lookups. A missing key, or a value that does not parse as
+    // the type, gives default_val.
+    std::string GetString(std::string_view key, const std::string& default_val) const;
+    int64_t GetInt(std::string_view key, int64_t default_val) const;
+    double GetDouble(std::string_view key, double default_val) const;
+    // true/false, yes/no, on/off or 1/0.
+    bool GetBool(std::string_view key, bool default_val) const;
+};
+
+class ConfigStore {
+   public:
+    // A snapshot held for reading. Keep it for a batch of lookups rather
+    // than acquiring one per lookup; a reload that happens meanwhile is
+    // seen by the next Read(). It must be destroyed on the thread that
+    // created it.
+    class View {
+       public:
+        const ConfigSnapshot& operator*() const { return *snapshot_; }
+        const ConfigSnapshot* operator->() const { return snapshot_; }
+
+       private:
+        friend class ConfigStore;
+        explicit View(const ConfigStore* store)
+            : snapshot_(store->current_.load(std::memory_order_acquire)) {}
+
+        EpochGuard guard_;  // constructed first, before the load
+        const ConfigSnapshot* snapshot_;
+    };
+
+    using ReloadCallback = std::function<void(const ConfigSnapshot&)>;
+
+    // Starts with an empty snapshot (version 0) until Load() succeeds.
+    // The callback runs on the watcher thread after each reload.
+    explicit ConfigStore(const std::string& path, ReloadCallback on_reload = nullptr);
+    ~ConfigStore();
+
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+
+    // Reads the file and publishes it. On failure the current snapshot
+    // is kept, the error is logged and false is returned.
+    bool Load();
+
+    // Starts watching the file and reloading it when it changes,
+    // including when an editor replaces it by renaming a new file over
+    // it. Returns false if watching is not supported here.
+    bool Watch();
+    void Stop();
+
+    View Read() const { return View(this); }
+    uint64_t Version() const { return Read()->version; }
+    const std::string& Path() const { return path_; }
+
+   private:
+    void Publish(ConfigSnapshot* next);
+    void WatchLoop();
+
+    std::string path_;
+    ReloadCallback on_reload_;
+    std::atomic<const ConfigSnapshot*> current_;
+    std::mutex load_mutex_;  // serializes Load() so versions increase
+    uint64_t next_version_ = 1;
+    std::thread thread_;
+    int inotify_fd_ = -1;
+    int stop_fd_ = -1;
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_CONFIGSTORE_H__
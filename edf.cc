@@ -0,0 +1,225 @@
+/**
+ * cpputil
+ *
+ * Earliest-deadline-first work queue for aperiodic jobs.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "edf.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace {
+
+// The job currently running on this thread, used by preemption points.
+struct RunningJob {
+    Utils::EdfScheduler* scheduler;
+    int64_t deadline;
+};
+
+thread_local RunningJob* current_job = nullptr;
+
+}  // namespace
+
+/**
+ * @brief Creates the scheduler and starts its worker threads.
+ *
+ * @param workers The number of worker threads. Zero or less uses one
+ * worker per hardware thread.
+ */
+Utils::EdfScheduler::EdfScheduler(int workers) {
+    if (workers <= 0) workers = std::max(1u, std::thread::hardware_concurrency());
+    queue_.Reserve(64);
+    for (int i = 0; i < workers; i++)
+        workers_.emplace_back(&EdfScheduler::WorkerLoop, this);
+}
+
+Utils::EdfScheduler::~EdfScheduler() { Stop(true); }
+
+int64_t Utils::EdfScheduler::NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               Now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief Queues a job with an absolute deadline.
+ *
+ * @param job The work to run.
+ * @param deadline The time by which the job should have completed.
+ *
+ * @return False if the scheduler is stopping and the job was rejected.
+ */
+bool Utils::EdfScheduler::Submit(Job job, Clock::time_point deadline) {
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     deadline.time_since_epoch())
+                     .count();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return false;
+        uint32_t slot;
+        if (!free_slots_.empty()) {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+            jobs_[slot] = std::move(job);
+        } else {
+            slot = (uint32_t)jobs_.size();
+            jobs_.push_back(std::move(job));
+        }
+        queue_.Push(Entry{ns, next_seq_++, slot});
+        PublishEarliest();
+    }
+    submitted_.fetch_add(1, std::memory_order_relaxed);
+    work_cv_.notify_one();
+    return true;
+}
+
+void Utils::EdfScheduler::PublishEarliest() {
+    earliest_.store(queue_.Empty() ? INT64_MAX : queue_.Top().deadline,
+                    std::memory_order_relaxed);
+}
+
+/**
+ * @brief Pops the most urgent job and runs it with the lock released.
+ *
+ * @param lock The held scheduler lock. It is held again on return.
+ * @param before Only run the head job if its deadline is earlier than this.
+ *
+ * @return True if a job was run.
+ */
+bool Utils::EdfScheduler::RunNext(std::unique_lock<std::mutex>& lock,
+                                  int64_t before) {
+    if (queue_.Empty() || queue_.Top().deadline >= before) return false;
+    Entry e = queue_.Pop();
+    Job job = std::move(jobs_[e.slot]);
+    jobs_[e.slot] = nullptr;
+    free_slots_.push_back(e.slot);
+    PublishEarliest();
+    running_++;
+    lock.unlock();
+    Execute(job, e.deadline);
+    lock.lock();
+    running_--;
+    if (queue_.Empty() && running_ == 0) idle_cv_.notify_all();
+    return true;
+}
+
+/**
+ * @brief Runs one job on the calling thread and accounts for it.
+ *
+ * Exceptions stop here. Letting one escape would kill a worker, or
+ * unwind through PreemptionPoint into the job that was preempted, so
+ * it is logged and counted as a failure instead.
+ */
+void Utils::EdfScheduler::Execute(Job& job, int64_t deadline) {
+    RunningJob self{this, deadline};
+    RunningJob* outer = current_job;
+    current_job = &self;
+    bool ok = true;
+    try {
+        job();
+    } catch (const std::exception& e) {
+        ok = false;
+        LogFmt("edf: job threw: %s", e.what());
+    } catch (...) {
+        ok = false;
+        LogFmt("edf: job threw");
+    }
+    current_job = outer;
+    if (!ok) {
+        failed_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    completed_.fetch_add(1, std::memory_order_relaxed);
+    int64_t late = NowNs() - deadline;
+    if (late > 0) {
+        missed_.fetch_add(1, std::memory_order_relaxed);
+        int64_t prev = max_lateness_.load(std::memory_order_relaxed);
+        while (late > prev &&
+               !max_lateness_.compare_exchange_weak(prev, late,
+                                                    std::memory_order_relaxed)) {
+        }
+    }
+}
+
+void Utils::EdfScheduler::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        work_cv_.wait(lock, [this] { return stopping_ || !queue_.Empty(); });
+        if (queue_.Empty()) return;  // stopping and nothing left to drain
+        RunNext(lock, INT64_MAX);
+    }
+}
+
+/**
+ * @brief Runs queued jobs that are more urgent than the current one.
+ *
+ * This is the cooperative preemption hook for long running jobs. The fast
+ * path, when nothing more urgent is queued, is a single relaxed atomic load.
+ *
+ * @return True if at least one job was run from this point.
+ */
+bool Utils::EdfScheduler::PreemptionPoint() {
+    RunningJob* self = current_job;
+    if (self == nullptr) return false;
+    EdfScheduler* s = self->scheduler;
+    if (s->earliest_.load(std::memory_order_relaxed) >= self->deadline)
+        return false;
+
+    bool ran = false;
+    std::unique_lock<std::mutex> lock(s->mutex_);
+    while (s->RunNext(lock, self->deadline)) {
+        s->preempted_.fetch_add(1, std::memory_order_relaxed);
+        ran = true;
+    }
+    return ran;
+}
+
+void Utils::EdfScheduler::Drain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_cv_.wait(lock, [this] { return queue_.Empty() && running_ == 0; });
+}
+
+/**
+ * @brief Stops the worker threads and joins them.
+ *
+ * @param drain If true the queued jobs are run before the workers exit,
+ * otherwise they are discarded.
+ */
+void Utils::EdfScheduler::Stop(bool drain) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ && workers_.empty()) return;
+        stopping_ = true;
+        if (!drain) {
+            queue_.Clear();
+            jobs_.clear();
+            free_slots_.clear();
+            PublishEarliest();
+        }
+    }
+    work_cv_.notify_all();
+    for (auto& t : workers_)
+        if (t.joinable()) t.join();
+    workers_.clear();
+    idle_cv_.notify_all();
+}
+
+Utils::EdfScheduler::Stats Utils::EdfScheduler::GetStats() const {
+    Stats s;
+    s.submitted = submitted_.load(std::memory_order_relaxed);
+    s.completed = completed_.load(std::memory_order_relaxed);
+    s.failed = failed_.load(std::memory_order_relaxed);
+    s.missed = missed_.load(std::memory_order_relaxed);
+    s.preempted = preempted_.load(std::memory_order_relaxed);
+    s.max_lateness = max_lateness_.load(std::memory_order_relaxed) / 1e9;
+    return s;
+}
+
+size_t Utils::EdfScheduler::Pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.Size();
+}
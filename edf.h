@@ -0,0 +1,196 @@
+/**
+ * cpputil
+ *
+ * Earliest-deadline-first work queue for aperiodic jobs. The
+ * periodic loops are paced by ScheduleRate, everything else
+ * (command processing, file flushes, ...) goes through here so
+ * urgent work is never stuck behind bulk work.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_EDF_H__
+#define __UTILCPP_EDF_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "utils.h"
+
+namespace Utils {
+
+// A d-ary min-heap stored in a flat vector. With D = 4 all the
+// children of a node share one or two cache lines, which makes
+// sift-down (the hot path of pop) much cheaper than a binary heap.
+// The top is the element that no other element compares less than.
+template <typename T, typename Compare = std::less<T>, size_t D = 4>
+class DaryHeap {
+    static_assert(D >= 2, "DaryHeap needs at least two children per node");
+
+   public:
+    explicit DaryHeap(Compare cmp = Compare()) : cmp_(cmp) {}
+
+    bool Empty() const { return data_.empty(); }
+    size_t Size() const { return data_.size(); }
+    const T& Top() const { return data_.front(); }
+    void Reserve(size_t n) { data_.reserve(n); }
+    void Clear() { data_.clear(); }
+
+    void Push(T value) {
+        data_.push_back(std::move(value));
+        SiftUp(data_.size() - 1);
+    }
+
+    T Pop() {
+        T top = std::move(data_.front());
+        if (data_.size() > 1) {
+            data_.front() = std::move(data_.back());
+            data_.pop_back();
+            SiftDown(0);
+        } else {
+            data_.pop_back();
+        }
+        return top;
+    }
+
+   private:
+    void SiftUp(size_t i) {
+        T value = std::move(data_[i]);
+        while (i > 0) {
+            size_t parent = (i - 1) / D;
+            if (!cmp_(value, data_[parent])) break;
+            data_[i] = std::move(data_[parent]);
+            i = parent;
+        }
+        data_[i] = std::move(value);
+    }
+
+    void SiftDown(size_t i) {
+        const size_t n = data_.size();
+        T value = std::move(data_[i]);
+        for (;;) {
+            size_t first = i * D + 1;
+            if (first >= n) break;
+            size_t last = first + D < n ? first + D : n;
+            size_t best = first;
+            for (size_t c = first + 1; c < last; c++)
+                if (cmp_(data_[c], data_[best])) best = c;
+            if (!cmp_(data_[best], value)) break;
+            data_[i] = std::move(data_[best]);
+            i = best;
+        }
+        data_[i] = std::move(value);
+    }
+
+    std::vector<T> data_;
+    Compare cmp_;
+};
+
+// Runs aperiodic jobs on a pool of worker threads, always picking
+// the job with the earliest deadline. Jobs that finish after their
+// deadline (read from the installed clock source) count as misses.
+// Long jobs can call EdfScheduler::PreemptionPoint() to let more
+// urgent work run on the same thread before they continue. A job that
+// throws is logged and counted as failed; the exception goes no further.
+class EdfScheduler {
+   public:
+    using Clock = std::chrono::high_resolution_clock;
+    using Job = std::function<void()>;
+
+    struct Stats {
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        uint64_t failed = 0;      // threw, and not counted as completed
+        uint64_t missed = 0;      // completed after their deadline
+        uint64_t preempted = 0;   // jobs run from a preemption point
+        double max_lateness = 0;  // seconds, worst deadline overrun
+    };
+
+    explicit EdfScheduler(int workers = 0);
+    ~EdfScheduler();
+
+    EdfScheduler(const EdfScheduler&) = delete;
+    EdfScheduler& operator=(const EdfScheduler&) = delete;
+
+    // Queues a job that should complete by the given deadline.
+    // Returns false if the scheduler has been stopped.
+    bool Submit(Job job, Clock::time_point deadline);
+
+    // Queues a job that should complete within the given duration.
+    template <typename Rep, typename Period>
+    bool SubmitIn(Job job, std::chrono::duration<Rep, Period> within) {
+        return Submit(std::move(job),
+                      Now() +
+                          std::chrono::duration_cast<Clock::duration>(within));
+    }
+
+    // Blocks until every queued job has completed.
+    void Drain();
+
+    // Stops the workers. With drain set the queued jobs run first,
+    // otherwise they are discarded. Called by the destructor.
+    void Stop(bool drain = true);
+
+    Stats GetStats() const;
+    size_t Pending() const;
+
+    // Called from inside a running job. If a job with an earlier
+    // deadline is waiting it is run right here, on the calling thread,
+    // before returning. Returns true if any job was run. Outside of
+    // a scheduler job this does nothing and returns false.
+    static bool PreemptionPoint();
+
+   private:
+    struct Entry {
+        int64_t deadline;  // ns since the clock epoch
+        uint64_t seq;      // FIFO order between equal deadlines
+        uint32_t slot;     // index into jobs_
+    };
+
+    struct EntryLess {
+        bool operator()(const Entry& a, const Entry& b) const {
+            return a.deadline < b.deadline ||
+                   (a.deadline == b.deadline && a.seq < b.seq);
+        }
+    };
+
+    void WorkerLoop();
+    bool RunNext(std::unique_lock<std::mutex>& lock, int64_t before);
+    void Execute(Job& job, int64_t deadline);
+    void PublishEarliest();
+
+    static int64_t NowNs();
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable idle_cv_;
+    DaryHeap<Entry, EntryLess> queue_;
+    std::vector<Job> jobs_;
+    std::vector<uint32_t> free_slots_;
+    std::vector<std::thread> workers_;
+    uint64_t next_seq_ = 0;
+    int running_ = 0;
+    bool stopping_ = false;
+
+    // Deadline of the queue head, readable without the lock so that
+    // preemption points cost one relaxed load when nothing is waiting.
+    std::atomic<int64_t> earliest_{INT64_MAX};
+
+    std::atomic<uint64_t> submitted_{0};
+    std::atomic<uint64_t> completed_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> missed_{0};
+    std::atomic<uint64_t> preempted_{0};
+    std::atomic<int64_t> max_lateness_{0};
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_EDF_H__
@@ -0,0 +1,164 @@
+/**
+ * cpputil
+ *
+ * Epoch-based memory reclamation.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "epoch.h"
+
+#include <mutex>
+#include <vector>
+
+// Epochs start at 1 so that 0 can mean "not in a guard".
+std::atomic<uint64_t> Utils::_global_epoch{1};
+
+namespace {
+
+std::atomic<Utils::_epoch_record*> records{nullptr};
+
+struct Retired {
+    void* p;
+    void (*deleter)(void*);
+    uint64_t epoch;
+};
+
+// Objects retired but not yet freed, over all threads.
+std::atomic<size_t> pending{0};
+
+// A thread tries to free its retired objects once per this many retires.
+constexpr size_t kCollectEvery = 64;
+
+// Objects left behind by threads that exited before they could be freed.
+std::mutex orphans_mutex;
+std::vector<Retired>* orphans = new std::vector<Retired>();
+
+// The calling thread's record and its retired objects. Both are handed
+// back when the thread exits.
+struct ThreadState {
+    Utils::_epoch_record* record = nullptr;
+    std::vector<Retired> retired;
+    size_t since_collect = 0;
+    ~ThreadState() {
+        if (!retired.empty()) {
+            std::lock_guard<std::mutex> lock(orphans_mutex);
+            orphans->insert(orphans->end(), retired.begin(), retired.end());
+        }
+        if (record == nullptr) return;
+        record->epoch.store(0, std::memory_order_release);
+        record->in_use.store(false, std::memory_order_release);
+    }
+};
+
+thread_local ThreadState thread_state;
+
+Utils::_epoch_record* ClaimRecord() {
+    for (auto* r = records.load(std::memory_order_acquire); r; r = r->next) {
+        bool expected = false;
+        if (!r->in_use.load(std::memory_order_relaxed) &&
+            r->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            return r;
+    }
+    auto* r = new Utils::_epoch_record();
+    r->in_use.store(true, std::memory_order_relaxed);
+    r->next = records.load(std::memory_order_relaxed);
+    while (!records.compare_exchange_weak(r->next, r, std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+    }
+    return r;
+}
+
+// The epoch moves from e to e + 1 once every thread inside a guard
+// entered it during e. Anything retired during e - 1 or earlier was
+// unlinked before all of those threads entered, so it is then safe to
+// free.
+uint64_t TryAdvance() {
+    uint64_t e = Utils::_global_epoch.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (auto* r = records.load(std::memory_order_acquire); r; r = r->next) {
+        // Acquire, so that a thread's reads inside its last guard happen
+        // before anything freed on the strength of this scan.
+        uint64_t local = r->epoch.load(std::memory_order_acquire);
+        if (local != 0 && local != e) return e;
+    }
+    Utils::_global_epoch.compare_exchange_strong(e, e + 1, std::memory_order_seq_cst);
+    return Utils::_global_epoch.load(std::memory_order_seq_cst);
+}
+
+// Frees the objects in list retired at least two epochs before e. The
+// due ones are moved out first, since a deleter may retire more objects
+// into the same list.
+size_t FreeDue(std::vector<Retired>& list, uint64_t e) {
+    std::vector<Retired> free_now;
+    size_t kept = 0;
+    for (Retired& r : list) {
+        if (r.epoch + 2 <= e)
+            free_now.push_back(r);
+        else
+            list[kept++] = r;
+    }
+    list.resize(kept);
+    for (Retired& r : free_now) r.deleter(r.p);
+    pending.fetch_sub(free_now.size(), std::memory_order_relaxed);
+    return free_now.size();
+}
+
+// Frees what has become safe to free in the calling thread's list, and
+// in the orphans if no other thread is at them. With force the orphans
+// are waited for.
+size_t Collect(bool force) {
+    uint64_t e = TryAdvance();
+    size_t freed = FreeDue(thread_state.retired, e);
+    std::unique_lock<std::mutex> lock(orphans_mutex, std::defer_lock);
+    if (force)
+        lock.lock();
+    else if (!lock.try_lock())
+        return freed;
+    std::vector<Retired> list;
+    list.swap(*orphans);
+    lock.unlock();
+    freed += FreeDue(list, e);
+    if (!list.empty()) {
+        lock.lock();
+        orphans->insert(orphans->end(), list.begin(), list.end());
+    }
+    return freed;
+}
+
+}  // namespace
+
+Utils::_epoch_record& Utils::_epoch_thread_record() {
+    if (thread_state.record == nullptr) thread_state.record = ClaimRecord();
+    return *thread_state.record;
+}
+
+/**
+ * @brief Schedules an unlinked object to be freed.
+ *
+ * The object is tagged with the current epoch and freed once the epoch
+ * has advanced twice, which cannot happen while any guard that might
+ * have seen it is still active. Retiring only appends to the calling
+ * thread's own list; every kCollectEvery retires the thread also tries
+ * to advance the epoch and frees what has become safe, so call it
+ * outside any lock that other threads wait on.
+ *
+ * @param p The object.
+ * @param deleter Frees it.
+ */
+void Utils::EpochRetire(void* p, void (*deleter)(void*)) {
+    thread_state.retired.push_back({p, deleter, _global_epoch.load(std::memory_order_seq_cst)});
+    pending.fetch_add(1, std::memory_order_relaxed);
+    if (++thread_state.since_collect >= kCollectEvery) {
+        thread_state.since_collect = 0;
+        Collect(false);
+    }
+}
+
+size_t Utils::EpochReclaim() {
+    // Freeing needs two advances past the newest retirement.
+    size_t freed = Collect(true);
+    return freed + Collect(true);
+}
+
+size_t Utils::EpochPending() { return pending.load(std::memory_order_relaxed); }
@@ -0,0 +1,85 @@
+/**
+ * cpputil
+ *
+ * Epoch-based memory reclamation, for data structures whose readers
+ * take no locks. A reader wraps its accesses in an EpochGuard; a writer
+ * that unlinks an object hands it to EpochRetire instead of deleting
+ * it. The object is freed once every thread that could still hold a
+ * pointer to it has left its guard. Entering and leaving a guard
+ * touches only the calling thread's own cache line.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_EPOCH_H__
+#define __UTILCPP_EPOCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+namespace Utils {
+
+// One per thread that has ever entered a guard, reused after the thread
+// exits. epoch is 0 while the thread is outside any guard, otherwise the
+// global epoch it saw on entry.
+struct alignas(64) _epoch_record {
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<bool> in_use{false};
+    _epoch_record* next = nullptr;
+    int nesting = 0;  // only touched by the owning thread
+};
+
+extern std::atomic<uint64_t> _global_epoch;
+
+// The calling thread's record, claimed on first use.
+_epoch_record& _epoch_thread_record();
+
+// Marks the calling thread as reading shared objects until the guard is
+// destroyed. Guards nest.
+class EpochGuard {
+   public:
+    EpochGuard() : record_(_epoch_thread_record()) {
+        if (record_.nesting++ == 0) {
+            record_.epoch.store(_global_epoch.load(std::memory_order_relaxed),
+                                std::memory_order_relaxed);
+            // Pairs with the fence in the epoch advance: either the
+            // advancing thread sees this one as active, or this one sees
+            // every unlink that happened before the advance.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+    ~EpochGuard() {
+        if (--record_.nesting == 0) record_.epoch.store(0, std::memory_order_release);
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+   private:
+    _epoch_record& record_;
+};
+
+// Frees p with deleter once no guard that was active when it was retired
+// is still active. Call it after p is unreachable for new readers, and
+// preferably after releasing any lock: it may run due deleters.
+void EpochRetire(void* p, void (*deleter)(void*));
+
+template <typename T>
+void EpochRetire(T* p) {
+    EpochRetire(static_cast<void*>(p), [](void* q) { delete static_cast<T*>(q); });
+}
+
+// Tries to advance the epoch and frees whatever has become safe to free
+// among the objects retired by the calling thread and by threads that
+// have exited. Retiring does this too, every so often; call it to
+// release memory when nothing is being retired. Returns the number of
+// objects freed.
+size_t EpochReclaim();
+
+// Objects retired but not yet freed, over all threads.
+size_t EpochPending();
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_EPOCH_H__
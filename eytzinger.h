@@ -0,0 +1,139 @@
+/**
+ * cpputil
+ *
+ * Read-optimized search over a static vector. EytzingerIndex stores the
+ * sorted values in breadth-first (Eytzinger) order: the root first, then
+ * both of its children, then the four grandchildren and so on. A search
+ * walks from the root with one branch-free comparison per level, and
+ * since the 16 great-great-grandchildren of a node share a cache line,
+ * that line is prefetched four levels ahead. Binary search over a sorted
+ * array instead touches a new, unpredictable line on every level once
+ * the array is larger than the cache, and mispredicts half its branches.
+ *
+ *     Utils::EytzingerIndex<uint32_t> ids(channel_ids);  // any order
+ *     long i = ids.IndexOf(id);  // index into channel_ids, or -1
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_EYTZINGER_H__
+#define __UTILCPP_EYTZINGER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <numeric>
+#include <vector>
+
+namespace Utils {
+
+// A std::allocator that aligns to Align bytes, so that the prefetch
+// target in EytzingerIndex always starts a cache line.
+template <typename T, size_t Align>
+struct _aligned_allocator {
+    using value_type = T;
+    template <typename U>
+    struct rebind {
+        using other = _aligned_allocator<U, Align>;
+    };
+
+    _aligned_allocator() = default;
+    template <typename U>
+    _aligned_allocator(const _aligned_allocator<U, Align>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(Align)); }
+
+    template <typename U>
+    bool operator==(const _aligned_allocator<U, Align>&) const { return true; }
+    template <typename U>
+    bool operator!=(const _aligned_allocator<U, Align>&) const { return false; }
+};
+
+template <typename T, typename Compare = std::less<T>>
+class EytzingerIndex {
+   public:
+    EytzingerIndex() : keys_(1), index_(1, -1) {}
+
+    // Builds the index over a copy of values, which need not be sorted.
+    // Searches return positions in values.
+    explicit EytzingerIndex(const std::vector<T>& values, Compare comp = Compare())
+        : comp_(comp) {
+        const size_t n = values.size();
+        std::vector<long> order(n);
+        std::iota(order.begin(), order.end(), 0L);
+        // Stable, so among equal values the earliest position comes first
+        // and is the one a search finds.
+        std::stable_sort(order.begin(), order.end(),
+                         [&](long a, long b) { return comp_(values[a], values[b]); });
+
+        // Slot 0 is unused so that the children of k are 2k and 2k + 1.
+        keys_.resize(n + 1);
+        index_.assign(n + 1, -1);
+        size_t next = 0;
+        Fill(values, order, 1, &next);
+    }
+
+    size_t Size() const { return keys_.size() - 1; }
+    bool Empty() const { return Size() == 0; }
+
+    // The position in the original vector of the first value not less
+    // than x, or -1 if every value is less.
+    long LowerBound(const T& x) const {
+        size_t k = Descend(x);
+        return k ? index_[k] : -1;
+    }
+
+    // The position in the original vector of a value equal to x (the
+    // earliest one if there are several), or -1.
+    long IndexOf(const T& x) const {
+        size_t k = Descend(x);
+        return k && !comp_(x, keys_[k]) ? index_[k] : -1;
+    }
+
+    bool Contains(const T& x) const { return IndexOf(x) >= 0; }
+
+   private:
+    // Values that fit a cache line this many times get prefetched.
+    static constexpr size_t kLine = 64;
+    static constexpr size_t kPerLine = sizeof(T) <= kLine ? kLine / sizeof(T) : 1;
+
+    // An in-order walk of the implicit tree visits slots in sorted order.
+    void Fill(const std::vector<T>& values, const std::vector<long>& order, size_t k,
+              size_t* next) {
+        if (k >= keys_.size()) return;
+        Fill(values, order, 2 * k, next);
+        keys_[k] = values[order[*next]];
+        index_[k] = order[*next];
+        (*next)++;
+        Fill(values, order, 2 * k + 1, next);
+    }
+
+    // Walks down to a leaf, going right whenever the key is less than x.
+    // The slot of the lower bound is where the walk last went left: strip
+    // the trailing right turns (one bits) and the final left turn. Returns
+    // 0 if there is no lower bound.
+    size_t Descend(const T& x) const {
+        const size_t n = Size();
+        const T* keys = keys_.data();
+        size_t k = 1;
+        while (k <= n) {
+            __builtin_prefetch(keys + std::min(k * kPerLine, n));
+            k = 2 * k + comp_(keys[k], x);
+        }
+        k >>= __builtin_ffsll(~(long long)k);
+        return k;
+    }
+
+    Compare comp_;
+    std::vector<T, _aligned_allocator<T, kLine>> keys_;
+    std::vector<long> index_;
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_EYTZINGER_H__
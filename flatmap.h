@@ -0,0 +1,317 @@
+/**
+ * cpputil
+ *
+ * A sorted map in two flat arrays, one of keys and one of values. A
+ * lookup is a binary search over contiguous keys instead of a walk
+ * down a red-black tree through a cache miss per node, and iteration
+ * is a linear scan. Inserting one element shifts everything after it,
+ * so build the map in one go (from a range, or with the batch insert)
+ * and treat it as read-mostly afterwards; configuration and channel
+ * tables are exactly that. The interface follows std::map so that it
+ * can stand in for one, including in MapGetOrDefault and MapFind.
+ *
+ * One difference: there is no stored pair to refer to, so iterators
+ * return a pair of references by value. Loop with
+ *
+ *     for (const auto& [key, value] : map)   // or auto, or auto&&
+ *
+ * since "for (auto& kv : map)" does not compile. Values can still be
+ * modified through kv.second in any of these forms.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_FLATMAP_H__
+#define __UTILCPP_FLATMAP_H__
+
+#include <stddef.h>
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Utils {
+
+// std::vector<bool> packs its elements into bits and hands out proxies,
+// which cannot be referred to as bool&. FlatMap keeps bool values in
+// these instead, one byte each.
+struct _flat_bool {
+    _flat_bool(bool v = false) : value(v) {}
+    operator bool&() { return value; }
+    operator const bool&() const { return value; }
+    bool value;
+};
+
+template <typename V>
+struct _flat_storage {
+    using type = V;
+};
+template <>
+struct _flat_storage<bool> {
+    using type = _flat_bool;
+};
+
+// The default comparator is std::less<>, which is transparent: a
+// FlatMap<std::string, V> can be searched with a const char* or a
+// std::string_view without building a std::string.
+template <typename K, typename V, typename Compare = std::less<>>
+class FlatMap {
+    template <bool Const>
+    class Iter;
+
+   public:
+    using key_type = K;
+    using mapped_type = V;
+    using key_compare = Compare;
+    using size_type = size_t;
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+    // V, except that bool is stored as _flat_bool.
+    using stored_type = typename _flat_storage<V>::type;
+
+    FlatMap() = default;
+    explicit FlatMap(Compare comp) : comp_(comp) {}
+
+    // Sorts the range once. For duplicate keys the first one is kept, as
+    // std::map does.
+    template <typename It>
+    FlatMap(It first, It last, Compare comp = Compare()) : comp_(comp) {
+        insert(first, last);
+    }
+
+    FlatMap(std::initializer_list<std::pair<K, V>> init, Compare comp = Compare())
+        : comp_(comp) {
+        insert(init.begin(), init.end());
+    }
+
+    size_t size() const { return keys_.size(); }
+    bool empty() const { return keys_.empty(); }
+    void reserve(size_t n) {
+        keys_.reserve(n);
+        values_.reserve(n);
+    }
+    void clear() {
+        keys_.clear();
+        values_.clear();
+    }
+
+    // The sorted keys, and the values in the same order.
+    const std::vector<K>& keys() const { return keys_; }
+    const std::vector<stored_type>& values() const { return values_; }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    template <typename Q = K>
+    iterator find(const Q& key) {
+        return iterator(this, Find(key));
+    }
+    template <typename Q = K>
+    const_iterator find(const Q& key) const {
+        return const_iterator(this, Find(key));
+    }
+    template <typename Q = K>
+    iterator lower_bound(const Q& key) {
+        return iterator(this, LowerBound(key));
+    }
+    template <typename Q = K>
+    const_iterator lower_bound(const Q& key) const {
+        return const_iterator(this, LowerBound(key));
+    }
+    template <typename Q = K>
+    bool contains(const Q& key) const {
+        return Find(key) != size();
+    }
+    template <typename Q = K>
+    size_t count(const Q& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    template <typename Q = K>
+    V& at(const Q& key) {
+        size_t i = Find(key);
+        if (i == size()) throw std::out_of_range("FlatMap::at");
+        return values_[i];
+    }
+    template <typename Q = K>
+    const V& at(const Q& key) const {
+        size_t i = Find(key);
+        if (i == size()) throw std::out_of_range("FlatMap::at");
+        return values_[i];
+    }
+
+    V& operator[](const K& key) { return try_emplace(key).first->second; }
+
+    // Inserts one element if the key is not present. This moves every
+    // later element, so prefer the range insert for more than a few. If
+    // constructing or inserting either half throws, the map is unchanged.
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+        size_t i = LowerBound(key);
+        if (i != size() && !comp_(key, keys_[i])) return {iterator(this, i), false};
+        stored_type value = V(std::forward<Args>(args)...);
+        keys_.insert(keys_.begin() + i, key);
+        try {
+            values_.insert(values_.begin() + i, std::move(value));
+        } catch (...) {
+            keys_.erase(keys_.begin() + i);
+            throw;
+        }
+        return {iterator(this, i), true};
+    }
+
+    std::pair<iterator, bool> insert(const std::pair<K, V>& kv) {
+        return try_emplace(kv.first, kv.second);
+    }
+
+    // Batch insert: sorts the new elements on their own and merges them
+    // with the existing ones in a single pass. Keys already present, or
+    // repeated in the range, keep their first value.
+    template <typename It>
+    void insert(It first, It last) {
+        std::vector<std::pair<K, V>> add(first, last);
+        std::stable_sort(add.begin(), add.end(), [this](const auto& a, const auto& b) {
+            return comp_(a.first, b.first);
+        });
+        add.erase(std::unique(add.begin(), add.end(),
+                              [this](const auto& a, const auto& b) {
+                                  return !comp_(a.first, b.first) && !comp_(b.first, a.first);
+                              }),
+                  add.end());
+
+        std::vector<K> keys;
+        std::vector<stored_type> values;
+        keys.reserve(keys_.size() + add.size());
+        values.reserve(keys_.size() + add.size());
+        size_t i = 0;
+        for (auto& kv : add) {
+            while (i < keys_.size() && comp_(keys_[i], kv.first)) {
+                keys.push_back(std::move(keys_[i]));
+                values.push_back(std::move(values_[i]));
+                i++;
+            }
+            if (i < keys_.size() && !comp_(kv.first, keys_[i])) continue;
+            keys.push_back(std::move(kv.first));
+            values.push_back(std::move(kv.second));
+        }
+        for (; i < keys_.size(); i++) {
+            keys.push_back(std::move(keys_[i]));
+            values.push_back(std::move(values_[i]));
+        }
+        keys_ = std::move(keys);
+        values_ = std::move(values);
+    }
+
+    template <typename Q = K>
+    size_t erase(const Q& key) {
+        size_t i = Find(key);
+        if (i == size()) return 0;
+        erase(iterator(this, i));
+        return 1;
+    }
+
+    iterator erase(const_iterator pos) {
+        keys_.erase(keys_.begin() + pos.i_);
+        values_.erase(values_.begin() + pos.i_);
+        return iterator(this, pos.i_);
+    }
+    iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+
+   private:
+    template <typename Q>
+    size_t LowerBound(const Q& key) const {
+        return std::lower_bound(keys_.begin(), keys_.end(), key, comp_) - keys_.begin();
+    }
+
+    template <typename Q>
+    size_t Find(const Q& key) const {
+        size_t i = LowerBound(key);
+        return i != size() && !comp_(key, keys_[i]) ? i : size();
+    }
+
+    // Iterators yield pairs of references into the two arrays, so
+    // it->first, it->second and structured bindings work as with
+    // std::map. They are random access. *it is a temporary, so it binds
+    // to auto, const auto& or auto&&, but not to auto&.
+    template <bool Const>
+    class Iter {
+        using Map = std::conditional_t<Const, const FlatMap, FlatMap>;
+        using Value = std::conditional_t<Const, const V, V>;
+
+       public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::pair<const K, V>;
+        using difference_type = ptrdiff_t;
+        using reference = std::pair<const K&, Value&>;
+
+        struct pointer {
+            reference ref;
+            const reference* operator->() const { return &ref; }
+        };
+
+        Iter() = default;
+        Iter(Map* map, size_t i) : map_(map), i_(i) {}
+        // iterator converts to const_iterator.
+        template <bool C = Const, typename = std::enable_if_t<C>>
+        Iter(const Iter<false>& o) : map_(o.map_), i_(o.i_) {}
+
+        reference operator*() const { return {map_->keys_[i_], map_->values_[i_]}; }
+        pointer operator->() const { return {**this}; }
+        reference operator[](difference_type n) const { return *(*this + n); }
+
+        Iter& operator++() {
+            i_++;
+            return *this;
+        }
+        Iter operator++(int) { return Iter(map_, i_++); }
+        Iter& operator--() {
+            i_--;
+            return *this;
+        }
+        Iter operator--(int) { return Iter(map_, i_--); }
+        Iter& operator+=(difference_type n) {
+            i_ += n;
+            return *this;
+        }
+        Iter& operator-=(difference_type n) {
+            i_ -= n;
+            return *this;
+        }
+        Iter operator+(difference_type n) const { return Iter(map_, i_ + n); }
+        Iter operator-(difference_type n) const { return Iter(map_, i_ - n); }
+        difference_type operator-(const Iter& o) const {
+            return (difference_type)i_ - (difference_type)o.i_;
+        }
+
+        bool operator==(const Iter& o) const { return i_ == o.i_; }
+        bool operator!=(const Iter& o) const { return i_ != o.i_; }
+        bool operator<(const Iter& o) const { return i_ < o.i_; }
+        bool operator>(const Iter& o) const { return i_ > o.i_; }
+        bool operator<=(const Iter& o) const { return i_ <= o.i_; }
+        bool operator>=(const Iter& o) const { return i_ >= o.i_; }
+
+       private:
+        friend class FlatMap;
+        template <bool>
+        friend class Iter;
+
+        Map* map_ = nullptr;
+        size_t i_ = 0;
+    };
+
+    Compare comp_;
+    std::vector<K> keys_;
+    std::vector<stored_type> values_;
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_FLATMAP_H__
@@ -0,0 +1,475 @@
+/**
+ * cpputil
+ *
+ * An open-addressing hash map in the style of Swiss tables. Besides
+ * the slot array there is one control byte per slot: empty, deleted,
+ * or, for a full slot, seven bits of the key's hash. A lookup loads 16
+ * control bytes at once, compares all of them with the hash bits in
+ * one SSE2 instruction, and only touches the slots whose bits match,
+ * which almost always means the one holding the key. Keys and values
+ * live in the slot array itself, with no per-element allocation, and
+ * trivially copyable ones are moved with memcpy when the table grows.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_HASHMAP_H__
+#define __UTILCPP_HASHMAP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Utils {
+
+// Hashes bytes eight at a time with multiply-mix rounds. Fast, and good
+// enough for tables; not for anything adversarial.
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0x9e3779b97f4a7c15ull) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint64_t k = 0xff51afd7ed558ccdull;
+    uint64_t h = seed ^ (size * k);
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ (w * k)) * 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 29;
+    }
+    uint64_t w = 0;
+    memcpy(&w, p, size);
+    h = (h ^ (w * k)) * 0xc4ceb9fe1a85ec53ull;
+    return h ^ (h >> 32);
+}
+
+// Spreads the bits of an integer over the whole 64-bit result, so that
+// sequential channel IDs do not land in sequential slots.
+constexpr uint64_t HashMix(uint64_t x) {
+    __uint128_t p = (__uint128_t)(x ^ 0x9e3779b97f4a7c15ull) * 0xd1b54a32d192ed03ull;
+    return (uint64_t)(p >> 64) ^ (uint64_t)p;
+}
+
+// The default hash for HashMap: mixed integers and pointers, and string
+// bytes for anything string-like. It is transparent, so a
+// HashMap<std::string, V> can be searched with a string_view or a
+// const char* without building a std::string.
+struct Hash {
+    using is_transparent = void;
+
+    template <typename T>
+    size_t operator()(const T& x) const {
+        if constexpr (std::is_integral<T>::value || std::is_enum<T>::value) {
+            return HashMix((uint64_t)x);
+        } else if constexpr (std::is_convertible<const T&, std::string_view>::value) {
+            std::string_view s = x;
+            return HashBytes(s.data(), s.size());
+        } else if constexpr (std::is_pointer<T>::value) {
+            return HashMix((uint64_t)(uintptr_t)x);
+        } else {
+            return HashMix(std::hash<T>()(x));
+        }
+    }
+};
+
+// Sixteen control bytes and the bit masks they produce.
+struct _ctrl_group {
+    static constexpr int8_t kEmpty = -128;   // 0b10000000
+    static constexpr int8_t kDeleted = -2;   // 0b11111110
+    static constexpr size_t kWidth = 16;
+
+#ifdef __SSE2__
+    explicit _ctrl_group(const int8_t* p) : ctrl(_mm_loadu_si128((const __m128i*)p)) {}
+
+    uint32_t Match(int8_t h2) const {
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2)));
+    }
+    uint32_t MatchEmpty() const { return Match(kEmpty); }
+    // Empty and deleted bytes are the negative ones.
+    uint32_t MatchEmptyOrDeleted() const { return (uint32_t)_mm_movemask_epi8(ctrl); }
+
+    __m128i ctrl;
+#else
+    explicit _ctrl_group(const int8_t* p) { memcpy(ctrl, p, kWidth); }
+
+    uint32_t Match(int8_t h2) const {
+        uint32_t m = 0;
+        for (size_t i = 0; i < kWidth; i++) m |= (uint32_t)(ctrl[i] == h2) << i;
+        return m;
+    }
+    uint32_t MatchEmpty() const { return Match(kEmpty); }
+    uint32_t MatchEmptyOrDeleted() const {
+        uint32_t m = 0;
+        for (size_t i = 0; i < kWidth; i++) m |= (uint32_t)(ctrl[i] < 0) << i;
+        return m;
+    }
+
+    int8_t ctrl[kWidth];
+#endif
+};
+
+// The table's capacity is a power of two, at least 16, and it grows
+// when it would be more than 7/8 full. Deletion leaves a tombstone only
+// when some probe may have passed over the slot on its way somewhere
+// else; otherwise the slot simply becomes empty again.
+template <typename K, typename V, typename HashFn = Hash, typename Eq = std::equal_to<>>
+class HashMap {
+    struct Slot {
+        K key;
+        V value;
+    };
+
+    static constexpr bool kTrivialSlots =
+        std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value;
+
+    template <bool Const>
+    class Iter;
+
+   public:
+    using key_type = K;
+    using mapped_type = V;
+    using size_type = size_t;
+    using hasher = HashFn;
+    using key_equal = Eq;
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    HashMap() = default;
+    explicit HashMap(size_t capacity, HashFn hash = HashFn(), Eq eq = Eq())
+        : hash_(hash), eq_(eq) {
+        reserve(capacity);
+    }
+
+    template <typename It>
+    HashMap(It first, It last) {
+        insert(first, last);
+    }
+
+    HashMap(std::initializer_list<std::pair<K, V>> init) { insert(init.begin(), init.end()); }
+
+    HashMap(const HashMap& o) : hash_(o.hash_), eq_(o.eq_) {
+        reserve(o.size());
+        for (auto kv : o) try_emplace(kv.first, kv.second);
+    }
+
+    HashMap(HashMap&& o) noexcept { Swap(o); }
+
+    HashMap& operator=(HashMap o) noexcept {
+        Swap(o);
+        return *this;
+    }
+
+    ~HashMap() { Destroy(); }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t capacity() const { return capacity_; }
+
+    // Makes room for n elements without growing again.
+    void reserve(size_t n) {
+        size_t cap = CapacityFor(n);
+        if (cap > capacity_) Resize(cap);
+    }
+
+    void clear() {
+        DestroySlots();
+        if (capacity_) {
+            memset(ctrl_, _ctrl_group::kEmpty, capacity_ + _ctrl_group::kWidth);
+            growth_left_ = MaxLoad(capacity_);
+        }
+        size_ = 0;
+    }
+
+    iterator begin() { return iterator(this, NextFull(0)); }
+    iterator end() { return iterator(this, capacity_); }
+    const_iterator begin() const { return const_iterator(this, NextFull(0)); }
+    const_iterator end() const { return const_iterator(this, capacity_); }
+
+    template <typename Q = K>
+    iterator find(const Q& key) {
+        return iterator(this, Find(key, hash_(key)));
+    }
+    template <typename Q = K>
+    const_iterator find(const Q& key) const {
+        return const_iterator(this, Find(key, hash_(key)));
+    }
+    template <typename Q = K>
+    bool contains(const Q& key) const {
+        return Find(key, hash_(key)) != capacity_;
+    }
+    template <typename Q = K>
+    size_t count(const Q& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    template <typename Q = K>
+    V& at(const Q& key) {
+        size_t i = Find(key, hash_(key));
+        if (i == capacity_) throw std::out_of_range("HashMap::at");
+        return slots_[i].value;
+    }
+    template <typename Q = K>
+    const V& at(const Q& key) const {
+        size_t i = Find(key, hash_(key));
+        if (i == capacity_) throw std::out_of_range("HashMap::at");
+        return slots_[i].value;
+    }
+
+    V& operator[](const K& key) { return try_emplace(key).first->second; }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+        size_t hash = hash_(key);
+        size_t i = Find(key, hash);
+        if (i != capacity_) return {iterator(this, i), false};
+        i = Claim(hash);
+        new (&slots_[i]) Slot{key, V(std::forward<Args>(args)...)};
+        Publish(i, hash);
+        return {iterator(this, i), true};
+    }
+
+    std::pair<iterator, bool> insert(const std::pair<K, V>& kv) {
+        return try_emplace(kv.first, kv.second);
+    }
+
+    template <typename It>
+    void insert(It first, It last) {
+        if constexpr (std::is_base_of<std::forward_iterator_tag,
+                                      typename std::iterator_traits<It>::iterator_category>::value)
+            reserve(size_ + std::distance(first, last));
+        for (; first != last; ++first) try_emplace(first->first, first->second);
+    }
+
+    template <typename Q = K>
+    size_t erase(const Q& key) {
+        size_t i = Find(key, hash_(key));
+        if (i == capacity_) return 0;
+        EraseAt(i);
+        return 1;
+    }
+
+    // Returns the iterator following pos.
+    iterator erase(const_iterator pos) {
+        EraseAt(pos.i_);
+        return iterator(this, NextFull(pos.i_ + 1));
+    }
+    iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+
+   private:
+    static constexpr size_t kWidth = _ctrl_group::kWidth;
+
+    static size_t MaxLoad(size_t capacity) { return capacity - capacity / 8; }
+
+    static size_t CapacityFor(size_t n) {
+        size_t cap = kWidth;
+        while (MaxLoad(cap) < n) cap *= 2;
+        return cap;
+    }
+
+    // The hash is split in two: the high bits choose where probing starts
+    // and the low seven go in the control byte.
+    static size_t H1(size_t hash) { return hash >> 7; }
+    static int8_t H2(size_t hash) { return (int8_t)(hash & 0x7f); }
+
+    void SetCtrl(size_t i, int8_t c) {
+        ctrl_[i] = c;
+        // The first group is mirrored after the end, so a group load that
+        // starts near the end wraps around without a second load.
+        if (i < kWidth) ctrl_[capacity_ + i] = c;
+    }
+
+    // Probes group by group, at triangular offsets from the start, which
+    // visits every group once when the capacity is a power of two.
+    template <typename Q>
+    size_t Find(const Q& key, size_t hash) const {
+        if (capacity_ == 0) return capacity_;
+        const size_t mask = capacity_ - 1;
+        const int8_t h2 = H2(hash);
+        size_t pos = H1(hash) & mask;
+        for (size_t step = kWidth;; step += kWidth) {
+            _ctrl_group g(ctrl_ + pos);
+            for (uint32_t m = g.Match(h2); m; m &= m - 1) {
+                size_t i = (pos + __builtin_ctz(m)) & mask;
+                if (eq_(slots_[i].key, key)) return i;
+            }
+            if (g.MatchEmpty()) return capacity_;
+            pos = (pos + step) & mask;
+        }
+    }
+
+    // Returns the first empty or deleted slot on the key's probe
+    // sequence, growing the table first if it is full. The slot stays
+    // free until Publish, so if constructing it throws the map is
+    // unchanged.
+    size_t Claim(size_t hash) {
+        if (growth_left_ == 0) Resize(CapacityFor(size_ + 1));
+        return FirstFree(hash);
+    }
+
+    // Marks a claimed slot full once the caller has constructed it.
+    void Publish(size_t i, size_t hash) {
+        if (ctrl_[i] == _ctrl_group::kEmpty) growth_left_--;
+        SetCtrl(i, H2(hash));
+        size_++;
+    }
+
+    size_t FirstFree(size_t hash) const {
+        const size_t mask = capacity_ - 1;
+        size_t pos = H1(hash) & mask;
+        for (size_t step = kWidth;; step += kWidth) {
+            if (uint32_t m = _ctrl_group(ctrl_ + pos).MatchEmptyOrDeleted())
+                return (pos + __builtin_ctz(m)) & mask;
+            pos = (pos + step) & mask;
+        }
+    }
+
+    // A probe only continues past a group with no empty slot. If every
+    // 16-slot window around i still has an empty slot, no probe ever
+    // passed through i, and it can go straight back to empty.
+    void EraseAt(size_t i) {
+        const size_t mask = capacity_ - 1;
+        slots_[i].~Slot();
+        size_--;
+        uint32_t empty_after = _ctrl_group(ctrl_ + i).MatchEmpty();
+        uint32_t empty_before = _ctrl_group(ctrl_ + ((i - kWidth) & mask)).MatchEmpty();
+        bool never_full = empty_after && empty_before &&
+                          (size_t)(__builtin_ctz(empty_after) +
+                                   __builtin_clz(empty_before << 16)) < kWidth;
+        if (never_full) {
+            SetCtrl(i, _ctrl_group::kEmpty);
+            growth_left_++;
+        } else {
+            SetCtrl(i, _ctrl_group::kDeleted);
+        }
+    }
+
+    // Rehashes into a table of the given capacity, which also clears out
+    // every tombstone.
+    void Resize(size_t capacity) {
+        int8_t* old_ctrl = ctrl_;
+        Slot* old_slots = slots_;
+        size_t old_capacity = capacity_;
+
+        ctrl_ = static_cast<int8_t*>(::operator new(capacity + kWidth));
+        memset(ctrl_, _ctrl_group::kEmpty, capacity + kWidth);
+        slots_ = static_cast<Slot*>(
+            ::operator new(capacity * sizeof(Slot), std::align_val_t(alignof(Slot))));
+        capacity_ = capacity;
+        growth_left_ = MaxLoad(capacity) - size_;
+
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_ctrl[i] < 0) continue;
+            size_t hash = hash_(old_slots[i].key);
+            size_t j = FirstFree(hash);
+            SetCtrl(j, H2(hash));
+            if constexpr (kTrivialSlots) {
+                memcpy((void*)&slots_[j], &old_slots[i], sizeof(Slot));
+            } else {
+                new (&slots_[j]) Slot(std::move(old_slots[i]));
+                old_slots[i].~Slot();
+            }
+        }
+        if (old_capacity) {
+            ::operator delete(old_ctrl);
+            ::operator delete(old_slots, std::align_val_t(alignof(Slot)));
+        }
+    }
+
+    void DestroySlots() {
+        if constexpr (!kTrivialSlots)
+            for (size_t i = 0; i < capacity_; i++)
+                if (ctrl_[i] >= 0) slots_[i].~Slot();
+    }
+
+    void Destroy() {
+        if (capacity_ == 0) return;
+        DestroySlots();
+        ::operator delete(ctrl_);
+        ::operator delete(slots_, std::align_val_t(alignof(Slot)));
+    }
+
+    void Swap(HashMap& o) noexcept {
+        std::swap(ctrl_, o.ctrl_);
+        std::swap(slots_, o.slots_);
+        std::swap(capacity_, o.capacity_);
+        std::swap(size_, o.size_);
+        std::swap(growth_left_, o.growth_left_);
+        std::swap(hash_, o.hash_);
+        std::swap(eq_, o.eq_);
+    }
+
+    size_t NextFull(size_t i) const {
+        while (i < capacity_ && ctrl_[i] < 0) i++;
+        return i;
+    }
+
+    // Iterators yield pairs of references, like FlatMap's. Inserting can
+    // rehash and invalidate them; erasing only invalidates the erased one.
+    template <bool Const>
+    class Iter {
+        using Map = std::conditional_t<Const, const HashMap, HashMap>;
+        using Value = std::conditional_t<Const, const V, V>;
+
+       public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<const K, V>;
+        using difference_type = ptrdiff_t;
+        using reference = std::pair<const K&, Value&>;
+
+        struct pointer {
+            reference ref;
+            const reference* operator->() const { return &ref; }
+        };
+
+        Iter() = default;
+        Iter(Map* map, size_t i) : map_(map), i_(i) {}
+        template <bool C = Const, typename = std::enable_if_t<C>>
+        Iter(const Iter<false>& o) : map_(o.map_), i_(o.i_) {}
+
+        reference operator*() const { return {map_->slots_[i_].key, map_->slots_[i_].value}; }
+        pointer operator->() const { return {**this}; }
+
+        Iter& operator++() {
+            i_ = map_->NextFull(i_ + 1);
+            return *this;
+        }
+        Iter operator++(int) {
+            Iter old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iter& o) const { return i_ == o.i_; }
+        bool operator!=(const Iter& o) const { return i_ != o.i_; }
+
+       private:
+        friend class HashMap;
+        template <bool>
+        friend class Iter;
+
+        Map* map_ = nullptr;
+        size_t i_ = 0;
+    };
+
+    int8_t* ctrl_ = nullptr;
+    Slot* slots_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    size_t growth_left_ = 0;
+    HashFn hash_;
+    Eq eq_;
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_HASHMAP_H__
@@ -0,0 +1,216 @@
+/**
+ * cpputil
+ *
+ * High-dynamic-range latency histograms. Values are bucketed on a
+ * log-linear scale, HdrHistogram style: exact below 2^bits, then
+ * a fixed number of linear sub-buckets per power of two, which
+ * bounds the relative error of every recorded value.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_HISTOGRAM_H__
+#define __UTILCPP_HISTOGRAM_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "utils.h"
+
+namespace Utils {
+
+// Maps values to bucket indices. With significant_bits = s, every value
+// lands in a bucket no wider than 2^-s of the value itself, e.g. s = 7
+// keeps the error under 0.8%.
+class HistogramLayout {
+   public:
+    HistogramLayout(int significant_bits, uint64_t max_value)
+        : bits_(significant_bits + 1),
+          sub_(uint64_t(1) << bits_),
+          half_(sub_ >> 1),
+          buckets_(Index(max_value) + 1) {}
+
+    size_t Buckets() const { return buckets_; }
+    int SignificantBits() const { return bits_ - 1; }
+
+    size_t Index(uint64_t v) const {
+        if (v < sub_) return (size_t)v;
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - bits_ + 1;
+        return (size_t)(sub_ + (uint64_t)(shift - 1) * half_ + ((v >> shift) - half_));
+    }
+
+    // Smallest value that maps to bucket i.
+    uint64_t Lowest(size_t i) const {
+        if (i < sub_) return i;
+        uint64_t shift = (i - sub_) / half_ + 1;
+        uint64_t mantissa = (i - sub_) % half_ + half_;
+        return mantissa << shift;
+    }
+
+    // Largest value that maps to bucket i.
+    uint64_t Highest(size_t i) const {
+        if (i < sub_) return i;
+        uint64_t shift = (i - sub_) / half_ + 1;
+        return Lowest(i) + ((uint64_t(1) << shift) - 1);
+    }
+
+    bool operator==(const HistogramLayout& o) const {
+        return bits_ == o.bits_ && buckets_ == o.buckets_;
+    }
+
+   private:
+    int bits_;
+    uint64_t sub_;
+    uint64_t half_;
+    size_t buckets_;
+};
+
+// A log-linear histogram of unsigned values (typically latencies in ns).
+// Recording is constant time. Counter is either uint64_t, for a
+// histogram owned by one thread (see Histogram), or std::atomic<uint64_t>
+// for one shared by many writers (see AtomicHistogram). Histograms with
+// the same layout can be merged, e.g. per-thread histograms into one
+// report.
+template <typename Counter>
+class BasicHistogram {
+    static constexpr bool kAtomic = !std::is_integral<Counter>::value;
+
+   public:
+    // Values above max_value are counted in the last bucket; Max() still
+    // reports them exactly.
+    explicit BasicHistogram(int significant_bits = 7,
+                            uint64_t max_value = uint64_t(3600) * 1000000000)
+        : layout_(significant_bits, max_value),
+          counts_(new Counter[layout_.Buckets()]()) {
+        Reset();
+    }
+
+    void Record(uint64_t value, uint64_t count = 1) {
+        size_t i = layout_.Index(value);
+        if (i >= layout_.Buckets()) i = layout_.Buckets() - 1;
+        Add(counts_[i], count);
+        Add(total_, count);
+        Add(sum_, value * count);
+        UpdateMin(value);
+        UpdateMax(value);
+    }
+
+    // Adds every value recorded in another histogram with the same layout.
+    // Returns false, merging nothing, if the layouts differ.
+    template <typename C>
+    bool Merge(const BasicHistogram<C>& other) {
+        if (!(layout_ == other.layout_)) return false;
+        for (size_t i = 0; i < layout_.Buckets(); i++) {
+            uint64_t c = Load(other.counts_[i]);
+            if (c) Add(counts_[i], c);
+        }
+        Add(total_, Load(other.total_));
+        Add(sum_, Load(other.sum_));
+        if (Load(other.total_)) {
+            UpdateMin(Load(other.min_));
+            UpdateMax(Load(other.max_));
+        }
+        return true;
+    }
+
+    void Reset() {
+        for (size_t i = 0; i < layout_.Buckets(); i++) Store(counts_[i], 0);
+        Store(total_, 0);
+        Store(sum_, 0);
+        Store(min_, UINT64_MAX);
+        Store(max_, 0);
+    }
+
+    uint64_t Count() const { return Load(total_); }
+    uint64_t Min() const { return Count() ? Load(min_) : 0; }
+    uint64_t Max() const { return Load(max_); }
+    double Mean() const { return Count() ? (double)Load(sum_) / Count() : 0.0; }
+
+    // The value below which the given percent (0-100) of recorded values
+    // fall, reported as the top of its bucket and capped at Max().
+    uint64_t Percentile(double percent) const {
+        uint64_t total = Count();
+        if (total == 0) return 0;
+        if (percent >= 100.0) return Max();
+        uint64_t rank = (uint64_t)(percent / 100.0 * total + 0.5);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < layout_.Buckets(); i++) {
+            seen += Load(counts_[i]);
+            if (seen >= rank) return std::min(layout_.Highest(i), Max());
+        }
+        return Max();
+    }
+
+    // Count, mean and the usual percentiles on one line. Values are
+    // divided by scale, e.g. 1000 to print ns as us.
+    std::string Summary(double scale = 1.0, const char* unit = "") const {
+        return StrFmt(
+            "n=%llu mean=%.2f%s p50=%.2f%s p99=%.2f%s p99.9=%.2f%s max=%.2f%s",
+            (unsigned long long)Count(), Mean() / scale, unit,
+            Percentile(50) / scale, unit, Percentile(99) / scale, unit,
+            Percentile(99.9) / scale, unit, Max() / scale, unit);
+    }
+
+    const HistogramLayout& Layout() const { return layout_; }
+    uint64_t BucketCount(size_t i) const { return Load(counts_[i]); }
+
+   private:
+    template <typename C>
+    friend class BasicHistogram;
+
+    static uint64_t Load(const uint64_t& c) { return c; }
+    static uint64_t Load(const std::atomic<uint64_t>& c) {
+        return c.load(std::memory_order_relaxed);
+    }
+    static void Store(uint64_t& c, uint64_t v) { c = v; }
+    static void Store(std::atomic<uint64_t>& c, uint64_t v) {
+        c.store(v, std::memory_order_relaxed);
+    }
+    static void Add(uint64_t& c, uint64_t v) { c += v; }
+    static void Add(std::atomic<uint64_t>& c, uint64_t v) {
+        c.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    void UpdateMin(uint64_t v) {
+        if constexpr (kAtomic) {
+            uint64_t cur = min_.load(std::memory_order_relaxed);
+            while (v < cur && !min_.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+            }
+        } else {
+            if (v < min_) min_ = v;
+        }
+    }
+
+    void UpdateMax(uint64_t v) {
+        if constexpr (kAtomic) {
+            uint64_t cur = max_.load(std::memory_order_relaxed);
+            while (v > cur && !max_.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+            }
+        } else {
+            if (v > max_) max_ = v;
+        }
+    }
+
+    HistogramLayout layout_;
+    std::unique_ptr<Counter[]> counts_;
+    Counter total_;
+    Counter sum_;
+    Counter min_;
+    Counter max_;
+};
+
+// For one writer thread, e.g. a per-thread histogram merged later.
+using Histogram = BasicHistogram<uint64_t>;
+
+// For many concurrent writers. Every update is a relaxed atomic.
+using AtomicHistogram = BasicHistogram<std::atomic<uint64_t>>;
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_HISTOGRAM_H__
@@ -0,0 +1,152 @@
+/**
+ * cpputil
+ *
+ * Sliding-window counters and EWMA rate meters.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "meters.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint64_t kTagMask = (1ull << 24) - 1;
+
+double NowSeconds() {
+    return std::chrono::duration<double>(Utils::Now().time_since_epoch()).count();
+}
+
+// The current whole second. A clock reading before its epoch counts as
+// second 0, so the result can always index the buckets.
+int64_t CurrentSecond() { return std::max<int64_t>((int64_t)NowSeconds(), 0); }
+
+}  // namespace
+
+unsigned Utils::MeterShard() {
+    static std::atomic<unsigned> next_thread{0};
+    thread_local unsigned shard =
+        next_thread.fetch_add(1, std::memory_order_relaxed) % kMeterShards;
+    return shard;
+}
+
+Utils::SlidingWindowCounter::SlidingWindowCounter() {
+    for (auto& shard : shards_)
+        for (auto& b : shard.buckets) b.store(kTagMask << kCountBits, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Counts n events in the current second.
+ *
+ * @param n The number of events.
+ */
+void Utils::SlidingWindowCounter::Add(uint64_t n) {
+    int64_t sec = CurrentSecond();
+    uint64_t tag = (uint64_t)sec & kTagMask;
+    std::atomic<uint64_t>& b = shards_[MeterShard()].buckets[sec % kBuckets];
+    uint64_t cur = b.load(std::memory_order_relaxed);
+    while ((cur >> kCountBits) != tag) {
+        // The bucket still holds an old second; start it over.
+        if (b.compare_exchange_weak(cur, (tag << kCountBits) | n,
+                                    std::memory_order_relaxed))
+            return;
+    }
+    b.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t Utils::SlidingWindowCounter::Count(std::chrono::seconds window) const {
+    int64_t sec = CurrentSecond();
+    int64_t w = std::min<int64_t>(window.count(), kBuckets - 2);
+    uint64_t total = 0;
+    for (const auto& shard : shards_) {
+        // Seconds before the clock's epoch were never counted, and would
+        // index the buckets with a negative number.
+        for (int64_t s = std::max<int64_t>(sec - w, 0); s <= sec; s++) {
+            uint64_t v = shard.buckets[s % kBuckets].load(std::memory_order_relaxed);
+            if ((v >> kCountBits) == ((uint64_t)s & kTagMask))
+                total += v & ((1ull << kCountBits) - 1);
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief Returns the event rate over the last window.
+ *
+ * The window covers the last whole seconds plus the part of the current
+ * second that has already gone by, so the rate does not sag right after
+ * a second boundary.
+ *
+ * @param window The window length in seconds, at most kBuckets - 2.
+ *
+ * @return Events per second.
+ */
+double Utils::SlidingWindowCounter::Rate(std::chrono::seconds window) const {
+    double now = NowSeconds();
+    int64_t w = std::min<int64_t>(window.count(), kBuckets - 2);
+    w = std::max<int64_t>(std::min<int64_t>(w, (int64_t)now), 0);
+    double elapsed = w + (now - std::floor(now));
+    return elapsed > 0 ? Count(std::chrono::seconds(w)) / elapsed : 0.0;
+}
+
+Utils::RateMeter::RateMeter() : start_(Now()), last_tick_(start_) {}
+
+uint64_t Utils::RateMeter::Total() const {
+    uint64_t total = 0;
+    for (const auto& shard : shards_) total += shard.count.load(std::memory_order_relaxed);
+    return total;
+}
+
+/**
+ * @brief Folds the events counted since the last tick into the moving
+ * averages, one update per whole second that has passed. Callers hold
+ * mutex_.
+ */
+void Utils::RateMeter::Tick() {
+    auto now = Now();
+    int64_t ticks = std::chrono::duration_cast<std::chrono::seconds>(now - last_tick_).count();
+    if (ticks <= 0) return;
+    last_tick_ += std::chrono::seconds(ticks);
+
+    uint64_t total = Total();
+    double instant = (double)(total - last_total_) / ticks;
+    last_total_ = total;
+
+    static const double a1 = 1.0 - std::exp(-1.0);
+    static const double a10 = 1.0 - std::exp(-1.0 / 10.0);
+    static const double a60 = 1.0 - std::exp(-1.0 / 60.0);
+    for (int64_t i = 0; i < ticks; i++) {
+        if (!primed_) {
+            rate_1s_ = rate_10s_ = rate_60s_ = instant;
+            primed_ = true;
+            continue;
+        }
+        rate_1s_ += a1 * (instant - rate_1s_);
+        rate_10s_ += a10 * (instant - rate_10s_);
+        rate_60s_ += a60 * (instant - rate_60s_);
+    }
+}
+
+double Utils::RateMeter::Rate1s() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Tick();
+    return rate_1s_;
+}
+
+double Utils::RateMeter::Rate10s() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Tick();
+    return rate_10s_;
+}
+
+double Utils::RateMeter::Rate60s() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Tick();
+    return rate_60s_;
+}
+
+double Utils::RateMeter::MeanRate() {
+    double elapsed = std::chrono::duration<double>(Now() - start_).count();
+    return elapsed > 0 ? Total() / elapsed : 0.0;
+}
@@ -0,0 +1,106 @@
+/**
+ * cpputil
+ *
+ * Sliding-window counters and EWMA rate meters, for messages per
+ * second, bytes per second, loop frequency and the like. Updates
+ * are one atomic add on a per-thread shard; reads aggregate.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_METERS_H__
+#define __UTILCPP_METERS_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "utils.h"
+
+namespace Utils {
+
+// The number of per-thread shards used by the meters below. Threads are
+// spread over them round-robin, so beyond this many writer threads some
+// share a cache line again.
+constexpr unsigned kMeterShards = 16;
+
+// Index of the calling thread's shard, assigned on first use.
+unsigned MeterShard();
+
+// Counts events in one second buckets covering the last minute. Add()
+// is one relaxed atomic add on the calling thread's shard, except once
+// per second per shard when a bucket has to be recycled. Rate() sums
+// the buckets of every shard. Time comes from the clock source.
+class SlidingWindowCounter {
+   public:
+    static constexpr int kBuckets = 64;  // seconds of history kept
+
+    SlidingWindowCounter();
+
+    void Add(uint64_t n = 1);
+
+    // Events counted in the last window, including the current partial
+    // second. Windows longer than kBuckets - 1 seconds are cut short.
+    uint64_t Count(std::chrono::seconds window) const;
+
+    // Events per second over the last window.
+    double Rate(std::chrono::seconds window) const;
+
+    double Rate1s() const { return Rate(std::chrono::seconds(1)); }
+    double Rate10s() const { return Rate(std::chrono::seconds(10)); }
+    double Rate60s() const { return Rate(std::chrono::seconds(60)); }
+
+   private:
+    // Each bucket packs the second it belongs to (low 24 bits of it) with
+    // the count, so recycling a bucket for a new second is one CAS and
+    // adds within the same second are a plain fetch_add.
+    static constexpr int kCountBits = 40;
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[kBuckets];
+    };
+
+    Shard shards_[kMeterShards];
+};
+
+// A UNIX load-average style meter: exponentially weighted moving rates
+// over 1, 10 and 60 seconds, plus the mean rate since creation. Mark()
+// is one relaxed atomic add on the calling thread's shard. The averages
+// are brought up to date, one tick per elapsed second, by whoever reads
+// them.
+class RateMeter {
+   public:
+    RateMeter();
+
+    void Mark(uint64_t n = 1) {
+        shards_[MeterShard()].count.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    double Rate1s();
+    double Rate10s();
+    double Rate60s();
+    double MeanRate();
+    uint64_t Total() const;
+
+   private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> count{0};
+    };
+
+    void Tick();
+
+    Shard shards_[kMeterShards];
+    std::mutex mutex_;  // readers only
+    std::chrono::high_resolution_clock::time_point start_;
+    std::chrono::high_resolution_clock::time_point last_tick_;
+    uint64_t last_total_ = 0;
+    bool primed_ = false;
+    double rate_1s_ = 0;
+    double rate_10s_ = 0;
+    double rate_60s_ = 0;
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_METERS_H__
@@ -0,0 +1,294 @@
+/**
+ * cpputil
+ *
+ * Metrics registry with Prometheus text exposition.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "metrics.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+uint64_t Utils::MetricCounter::Value() const {
+    uint64_t total = 0;
+    for (const auto& s : shards_) total += s.value.load(std::memory_order_relaxed);
+    return total;
+}
+
+void Utils::MetricGauge::Add(double d) {
+    double cur = value_.load(std::memory_order_relaxed);
+    while (!value_.compare_exchange_weak(cur, cur + d, std::memory_order_relaxed)) {
+    }
+}
+
+Utils::MetricHistogram::MetricHistogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)) {
+    std::sort(bounds_.begin(), bounds_.end());
+    for (auto& s : shards_) {
+        s.counts.reset(new std::atomic<uint64_t>[bounds_.size() + 1]);
+        for (size_t i = 0; i <= bounds_.size(); i++) s.counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Records one observation in the calling thread's shard.
+ *
+ * @param v The observed value.
+ */
+void Utils::MetricHistogram::Observe(double v) {
+    size_t i = std::lower_bound(bounds_.begin(), bounds_.end(), v) - bounds_.begin();
+    Shard& s = shards_[MeterShard()];
+    s.counts[i].fetch_add(1, std::memory_order_relaxed);
+    double cur = s.sum.load(std::memory_order_relaxed);
+    while (!s.sum.compare_exchange_weak(cur, cur + v, std::memory_order_relaxed)) {
+    }
+}
+
+std::vector<uint64_t> Utils::MetricHistogram::Counts() const {
+    std::vector<uint64_t> counts(bounds_.size() + 1, 0);
+    for (const auto& s : shards_)
+        for (size_t i = 0; i < counts.size(); i++)
+            counts[i] += s.counts[i].load(std::memory_order_relaxed);
+    return counts;
+}
+
+double Utils::MetricHistogram::Sum() const {
+    double sum = 0;
+    for (const auto& s : shards_) sum += s.sum.load(std::memory_order_relaxed);
+    return sum;
+}
+
+std::vector<double> Utils::ExponentialBuckets(double start, double factor, int count) {
+    std::vector<double> bounds;
+    for (int i = 0; i < count; i++, start *= factor) bounds.push_back(start);
+    return bounds;
+}
+
+Utils::MetricsRegistry::Family& Utils::MetricsRegistry::GetFamily(
+    const std::string& name, const std::string& help, const char* type) {
+    auto it = families_.find(name);
+    if (it == families_.end()) {
+        it = families_.emplace(name, Family()).first;
+        it->second.help = help;
+        it->second.type = type;
+    } else if (strcmp(it->second.type, type) != 0) {
+        ErrFmt("metric %s registered as both %s and %s", name, it->second.type, type);
+    }
+    return it->second;
+}
+
+Utils::MetricCounter& Utils::MetricsRegistry::Counter(const std::string& name,
+                                                      const std::string& help,
+                                                      const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& slot = GetFamily(name, help, "counter").counters[labels];
+    if (!slot) slot = std::make_unique<MetricCounter>();
+    return *slot;
+}
+
+Utils::MetricGauge& Utils::MetricsRegistry::Gauge(const std::string& name,
+                                                  const std::string& help,
+                                                  const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& slot = GetFamily(name, help, "gauge").gauges[labels];
+    if (!slot) slot = std::make_unique<MetricGauge>();
+    return *slot;
+}
+
+Utils::MetricHistogram& Utils::MetricsRegistry::Histogram(const std::string& name,
+                                                          const std::string& help,
+                                                          const std::vector<double>& bounds,
+                                                          const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& slot = GetFamily(name, help, "histogram").histograms[labels];
+    if (!slot) slot = std::make_unique<MetricHistogram>(bounds);
+    return *slot;
+}
+
+namespace {
+
+// HELP text may contain anything except a raw newline; the format
+// escapes backslashes and newlines.
+std::string EscapeHelp(const std::string& help) {
+    std::string out;
+    out.reserve(help.size());
+    for (char c : help) {
+        if (c == '\\')
+            out += "\\\\";
+        else if (c == '\n')
+            out += "\\n";
+        else
+            out += c;
+    }
+    return out;
+}
+
+std::string Braced(const std::string& labels, const std::string& extra = "") {
+    if (labels.empty() && extra.empty()) return "";
+    if (labels.empty()) return "{" + extra + "}";
+    if (extra.empty()) return "{" + labels + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+std::string FormatValue(double v) {
+    if (std::isinf(v)) return v > 0 ? "+Inf" : "-Inf";
+    // Prefer the short form when it round-trips, so bounds like 0.004 do
+    // not print as 0.0040000000000000001.
+    std::string s = Utils::StrFmt("%.15g", v);
+    return strtod(s.c_str(), nullptr) == v ? s : Utils::StrFmt("%.17g", v);
+}
+
+}  // namespace
+
+/**
+ * @brief Renders every metric in the Prometheus text exposition format.
+ *
+ * Reading a metric is a handful of relaxed loads over its shards, so a
+ * scrape holds the registry lock (which blocks registration only) but
+ * never anything the instrumented threads touch.
+ *
+ * @return The exposition text.
+ */
+std::string Utils::MetricsRegistry::Expose() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out;
+    for (const auto& [name, family] : families_) {
+        out += "# HELP " + name + " " + EscapeHelp(family.help) + "\n";
+        out += "# TYPE " + name + " " + family.type + "\n";
+        for (const auto& [labels, c] : family.counters)
+            out += StrFmt("%s%s %llu\n", name, Braced(labels), (unsigned long long)c->Value());
+        for (const auto& [labels, g] : family.gauges)
+            out += name + Braced(labels) + " " + FormatValue(g->Value()) + "\n";
+        for (const auto& [labels, h] : family.histograms) {
+            std::vector<uint64_t> counts = h->Counts();
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < counts.size(); i++) {
+                cumulative += counts[i];
+                std::string le = i < h->Bounds().size() ? FormatValue(h->Bounds()[i]) : "+Inf";
+                out += StrFmt("%s_bucket%s %llu\n", name, Braced(labels, "le=\"" + le + "\""),
+                              (unsigned long long)cumulative);
+            }
+            out += name + "_sum" + Braced(labels) + " " + FormatValue(h->Sum()) + "\n";
+            out += StrFmt("%s_count%s %llu\n", name, Braced(labels), (unsigned long long)cumulative);
+        }
+    }
+    return out;
+}
+
+Utils::MetricsRegistry& Utils::Metrics() {
+    static MetricsRegistry* registry = new MetricsRegistry();
+    return *registry;
+}
+
+Utils::MetricsFileExporter::MetricsFileExporter(MetricsRegistry& registry,
+                                                const std::string& path,
+                                                std::chrono::milliseconds interval)
+    : registry_(registry), path_(path), interval_(interval) {
+    thread_ = std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            cv_.wait_for(lock, interval_);
+            WriteNow();
+        }
+    });
+}
+
+Utils::MetricsFileExporter::~MetricsFileExporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+bool Utils::MetricsFileExporter::WriteNow() {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    std::string tmp = path_ + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::out | std::ios::trunc);
+        if (!out) return false;
+        out << registry_.Expose();
+        if (!out) return false;
+    }
+    return rename(tmp.c_str(), path_.c_str()) == 0;
+}
+
+/**
+ * @brief Binds 127.0.0.1:port and starts serving.
+ *
+ * @param registry The registry to expose.
+ * @param port The TCP port, or 0 to let the kernel pick one (see Port()).
+ */
+Utils::MetricsHttpServer::MetricsHttpServer(MetricsRegistry& registry, uint16_t port)
+    : registry_(registry), port_(port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error_ = StrFmt("socket: %s", strerror(errno));
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+        error_ = StrFmt("bind 127.0.0.1:%d: %s", (int)port, strerror(errno));
+        close(fd);
+        return;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    port_ = ntohs(addr.sin_port);
+    listen_fd_ = fd;
+    thread_ = std::thread(&MetricsHttpServer::Serve, this);
+}
+
+Utils::MetricsHttpServer::~MetricsHttpServer() {
+    stop_.store(true);
+    if (thread_.joinable()) thread_.join();
+    if (listen_fd_ >= 0) close(listen_fd_);
+}
+
+void Utils::MetricsHttpServer::Serve() {
+    while (!stop_.load()) {
+        pollfd p{listen_fd_, POLLIN, 0};
+        if (poll(&p, 1, 200) <= 0) continue;
+        int client = accept(listen_fd_, nullptr, nullptr);
+        if (client < 0) continue;
+
+        // Read (and ignore) the request head, but never wait long for it.
+        char buf[1024];
+        pollfd c{client, POLLIN, 0};
+        if (poll(&c, 1, 1000) > 0) {
+            ssize_t n = recv(client, buf, sizeof(buf), 0);
+            (void)n;
+        }
+
+        std::string body = registry_.Expose();
+        std::string response = StrFmt(
+            "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %zu\r\n"
+            "Connection: close\r\n\r\n",
+            body.size());
+        response += body;
+        for (size_t sent = 0; sent < response.size();) {
+            ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            sent += n;
+        }
+        close(client);
+    }
+}
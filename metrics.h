@@ -0,0 +1,169 @@
+/**
+ * cpputil
+ *
+ * A small metrics registry with counters, gauges and histograms,
+ * exposed in the Prometheus text format either as a file rewritten
+ * periodically or from a tiny HTTP endpoint on loopback. Updates
+ * go to cache-line padded per-thread shards and never take a lock;
+ * only registration and scraping do.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_METRICS_H__
+#define __UTILCPP_METRICS_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "meters.h"
+
+namespace Utils {
+
+// A monotonically increasing count.
+class MetricCounter {
+   public:
+    void Inc(uint64_t n = 1) {
+        shards_[MeterShard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t Value() const;
+
+   private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    Shard shards_[kMeterShards];
+};
+
+// A value that goes up and down. Set() is last-writer-wins, so a gauge
+// is not sharded; it still sits alone on its cache line.
+class alignas(64) MetricGauge {
+   public:
+    void Set(double v) { value_.store(v, std::memory_order_relaxed); }
+    void Add(double d);
+    double Value() const { return value_.load(std::memory_order_relaxed); }
+
+   private:
+    std::atomic<double> value_{0.0};
+};
+
+// A Prometheus histogram: counts of observations at or below each upper
+// bound, plus their sum.
+class MetricHistogram {
+   public:
+    explicit MetricHistogram(std::vector<double> bounds);
+
+    void Observe(double v);
+
+    const std::vector<double>& Bounds() const { return bounds_; }
+    // Per-bucket (not cumulative) counts, the last one for +Inf.
+    std::vector<uint64_t> Counts() const;
+    double Sum() const;
+
+   private:
+    struct alignas(64) Shard {
+        std::unique_ptr<std::atomic<uint64_t>[]> counts;
+        std::atomic<double> sum{0.0};
+    };
+
+    std::vector<double> bounds_;
+    Shard shards_[kMeterShards];
+};
+
+// Upper bounds from start, each factor times the previous one.
+std::vector<double> ExponentialBuckets(double start, double factor, int count);
+
+// Owns metrics by name and renders them. Metrics are created on first
+// lookup and live as long as the registry, so callers look them up once
+// and keep the reference. Labels are given preformatted, e.g.
+// "loop=\"nav\"".
+class MetricsRegistry {
+   public:
+    MetricCounter& Counter(const std::string& name, const std::string& help,
+                           const std::string& labels = "");
+    MetricGauge& Gauge(const std::string& name, const std::string& help,
+                       const std::string& labels = "");
+    // The bounds are only used when the histogram is created.
+    MetricHistogram& Histogram(const std::string& name, const std::string& help,
+                               const std::vector<double>& bounds,
+                               const std::string& labels = "");
+
+    // The whole registry in the Prometheus text exposition format.
+    std::string Expose() const;
+
+   private:
+    struct Family {
+        std::string help;
+        const char* type;
+        std::map<std::string, std::unique_ptr<MetricCounter>> counters;
+        std::map<std::string, std::unique_ptr<MetricGauge>> gauges;
+        std::map<std::string, std::unique_ptr<MetricHistogram>> histograms;
+    };
+
+    Family& GetFamily(const std::string& name, const std::string& help, const char* type);
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Family> families_;
+};
+
+// The process-wide registry.
+MetricsRegistry& Metrics();
+
+// Rewrites a file with the exposition every interval, for node_exporter's
+// textfile collector or anything else that reads files. The file is
+// replaced atomically by renaming a temporary next to it.
+class MetricsFileExporter {
+   public:
+    MetricsFileExporter(MetricsRegistry& registry, const std::string& path,
+                        std::chrono::milliseconds interval = std::chrono::seconds(10));
+    ~MetricsFileExporter();
+
+    // Writes the file now. Safe to call while the exporter thread runs.
+    bool WriteNow();
+
+   private:
+    MetricsRegistry& registry_;
+    std::string path_;
+    std::chrono::milliseconds interval_;
+    std::mutex write_mutex_;  // one writer of the temporary file at a time
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+// Serves the exposition over HTTP on 127.0.0.1 from its own thread. Any
+// request gets the metrics; this is for a local scraper, not the
+// internet.
+class MetricsHttpServer {
+   public:
+    MetricsHttpServer(MetricsRegistry& registry, uint16_t port);
+    ~MetricsHttpServer();
+
+    // False if the socket could not be bound; see Error().
+    bool Running() const { return listen_fd_ >= 0; }
+    const std::string& Error() const { return error_; }
+    uint16_t Port() const { return port_; }
+
+   private:
+    void Serve();
+
+    MetricsRegistry& registry_;
+    uint16_t port_;
+    int listen_fd_ = -1;
+    std::string error_;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_METRICS_H__
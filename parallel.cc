@@ -0,0 +1,80 @@
+/**
+ * cpputil
+ *
+ * Fork-join thread pool for the parallel searches.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "parallel.h"
+
+namespace {
+
+// Set while a thread runs a pool body, to catch nested RunOnAll calls.
+thread_local bool in_pool_body = false;
+
+}  // namespace
+
+Utils::ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < threads; i++) workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+Utils::ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto& w : workers_) w.join();
+}
+
+/**
+ * @brief Runs body on every worker and on the calling thread, and waits
+ * for all of them to return.
+ *
+ * @param body The function to run. It must be safe to call concurrently.
+ */
+void Utils::ThreadPool::RunOnAll(const std::function<void()>& body) {
+    if (in_pool_body || workers_.empty()) {
+        body();
+        return;
+    }
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &body;
+        running_ = (int)workers_.size();
+        generation_++;
+    }
+    start_cv_.notify_all();
+
+    in_pool_body = true;
+    body();
+    in_pool_body = false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return running_ == 0; });
+    job_ = nullptr;
+}
+
+void Utils::ThreadPool::WorkerLoop() {
+    in_pool_body = true;
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        start_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_) return;
+        seen = generation_;
+        const std::function<void()>* job = job_;
+        lock.unlock();
+        (*job)();
+        lock.lock();
+        if (--running_ == 0) done_cv_.notify_one();
+    }
+}
+
+Utils::ThreadPool& Utils::DefaultThreadPool() {
+    static ThreadPool* pool = new ThreadPool();
+    return *pool;
+}
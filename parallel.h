@@ -0,0 +1,160 @@
+/**
+ * cpputil
+ *
+ * Parallel search over very large arrays. A vectorized scan is bound by
+ * one core's memory bandwidth; ParallelIndexOf, ParallelContains and
+ * ParallelCount split the array into chunks that every thread of a
+ * pool pulls in order. A match stops the chunks after it from being
+ * scanned, and the index returned is still the first occurrence. Below
+ * kParallelSearchMinBytes waking the pool costs more than it saves, so
+ * small arrays are searched on the calling thread.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_PARALLEL_H__
+#define __UTILCPP_PARALLEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vecsearch.h"
+
+namespace Utils {
+
+// A fork-join pool: RunOnAll runs one function on every worker and the
+// calling thread together. The function usually pulls work from a
+// shared atomic counter, so uneven chunks balance themselves.
+class ThreadPool {
+   public:
+    // threads counts the calling thread, so a pool of n starts n - 1
+    // workers. Zero or less uses one thread per hardware thread.
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int Threads() const { return (int)workers_.size() + 1; }
+
+    // Runs body on all threads and returns when every one has returned.
+    // Concurrent callers take turns. Called from inside a body, it runs
+    // body on the calling thread alone rather than deadlock.
+    void RunOnAll(const std::function<void()>& body);
+
+   private:
+    void WorkerLoop();
+
+    std::vector<std::thread> workers_;
+    std::mutex run_mutex_;  // one RunOnAll at a time
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void()>* job_ = nullptr;
+    uint64_t generation_ = 0;
+    int running_ = 0;
+    bool stop_ = false;
+};
+
+// The pool the parallel searches use by default, started on first use.
+ThreadPool& DefaultThreadPool();
+
+// Arrays smaller than this are searched serially. Waking the pool and
+// joining it costs a few microseconds, about what one core needs to scan
+// this much with SIMD.
+constexpr size_t kParallelSearchMinBytes = 4 << 20;
+
+// Work is handed out in chunks of this size; a match is noticed by the
+// other threads at the next chunk boundary.
+constexpr size_t kParallelSearchChunkBytes = 256 << 10;
+
+template <typename T>
+size_t _parallel_find(const T* data, size_t size, const T& x, bool any, ThreadPool& pool) {
+    if (size * sizeof(T) < kParallelSearchMinBytes || pool.Threads() == 1)
+        return FindFirst(data, size, x);
+
+    const size_t chunk = std::max<size_t>(kParallelSearchChunkBytes / sizeof(T), 1);
+    const size_t chunks = (size + chunk - 1) / chunk;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> found{size};
+    pool.RunOnAll([&] {
+        for (;;) {
+            size_t c = next.fetch_add(1, std::memory_order_relaxed);
+            if (c >= chunks) return;
+            size_t begin = c * chunk;
+            // Chunks are handed out in order, so once one starts past the
+            // best match so far every later one does too.
+            size_t best = found.load(std::memory_order_relaxed);
+            if (begin >= best || (any && best != size)) return;
+            size_t end = std::min(size, begin + chunk);
+            size_t i = FindFirst(data + begin, end - begin, x);
+            if (i == end - begin) continue;
+            size_t index = begin + i;
+            while (index < best &&
+                   !found.compare_exchange_weak(best, index, std::memory_order_relaxed)) {
+            }
+            return;
+        }
+    });
+    return found.load(std::memory_order_relaxed);
+}
+
+// The index of the first element of data[0, size) equal to x, or size if
+// there is none.
+template <typename T>
+size_t ParallelFindFirst(const T* data, size_t size, const T& x,
+                         ThreadPool& pool = DefaultThreadPool()) {
+    return _parallel_find(data, size, x, false, pool);
+}
+
+// Returns the index of the first element equal to x, otherwise -1.
+template <typename T>
+long ParallelIndexOf(const std::vector<T>& v, const T& x, ThreadPool& pool = DefaultThreadPool()) {
+    size_t pos = _parallel_find(v.data(), v.size(), x, false, pool);
+    return pos == v.size() ? -1 : (long)pos;
+}
+
+// Returns true if x is present. Any match stops every thread, so this
+// can return sooner than ParallelIndexOf.
+template <typename T>
+bool ParallelContains(const std::vector<T>& v, const T& x, ThreadPool& pool = DefaultThreadPool()) {
+    return _parallel_find(v.data(), v.size(), x, true, pool) != v.size();
+}
+
+// The number of elements of data[0, size) equal to x.
+template <typename T>
+size_t ParallelCount(const T* data, size_t size, const T& x,
+                     ThreadPool& pool = DefaultThreadPool()) {
+    if (size * sizeof(T) < kParallelSearchMinBytes || pool.Threads() == 1)
+        return CountEqual(data, size, x);
+
+    const size_t chunk = std::max<size_t>(kParallelSearchChunkBytes / sizeof(T), 1);
+    const size_t chunks = (size + chunk - 1) / chunk;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> total{0};
+    pool.RunOnAll([&] {
+        size_t count = 0;
+        for (size_t c; (c = next.fetch_add(1, std::memory_order_relaxed)) < chunks;) {
+            size_t begin = c * chunk;
+            count += CountEqual(data + begin, std::min(size, begin + chunk) - begin, x);
+        }
+        total.fetch_add(count, std::memory_order_relaxed);
+    });
+    return total.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+size_t ParallelCount(const std::vector<T>& v, const T& x, ThreadPool& pool = DefaultThreadPool()) {
+    return ParallelCount(v.data(), v.size(), x, pool);
+}
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_PARALLEL_H__
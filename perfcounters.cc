@@ -0,0 +1,207 @@
+/**
+ * cpputil
+ *
+ * Hardware performance counters for scoped regions.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "perfcounters.h"
+
+#include <string.h>
+
+#include "utils.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+Utils::PerfSample& Utils::PerfSample::operator+=(const PerfSample& o) {
+    cycles += o.cycles;
+    instructions += o.instructions;
+    cache_misses += o.cache_misses;
+    branch_misses += o.branch_misses;
+    return *this;
+}
+
+Utils::PerfSample Utils::PerfSample::operator-(const PerfSample& o) const {
+    PerfSample d;
+    d.cycles = cycles - o.cycles;
+    d.instructions = instructions - o.instructions;
+    d.cache_misses = cache_misses - o.cache_misses;
+    d.branch_misses = branch_misses - o.branch_misses;
+    return d;
+}
+
+#ifdef __linux__
+namespace {
+
+const uint64_t kEvents[] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int OpenCounter(uint64_t config, int group_fd) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group_fd < 0 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+inline uint64_t Rdpmc(uint32_t counter) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(counter));
+    return ((uint64_t)hi << 32) | lo;
+}
+#define UTILS_HAVE_RDPMC 1
+#endif
+
+}  // namespace
+#endif
+
+/**
+ * @brief Opens cycle, instruction, cache miss and branch miss counters for
+ * the calling thread as one group, so they are scheduled together.
+ *
+ * Failure is not fatal: if the cycle counter cannot be opened (usually
+ * perf_event_paranoid or a container without PMU access) the object is
+ * unavailable and Error() says why. If only some of the other counters
+ * fail they read as zero.
+ */
+Utils::PerfCounters::PerfCounters() {
+    for (int i = 0; i < kCounters; i++) {
+        fds_[i] = -1;
+        pages_[i] = nullptr;
+    }
+#ifdef __linux__
+    fds_[0] = OpenCounter(kEvents[0], -1);
+    if (fds_[0] < 0) {
+        error_ = StrFmt("perf_event_open: %s (see /proc/sys/kernel/perf_event_paranoid)",
+                        strerror(errno));
+        return;
+    }
+    for (int i = 1; i < kCounters; i++) fds_[i] = OpenCounter(kEvents[i], fds_[0]);
+
+#ifdef UTILS_HAVE_RDPMC
+    fast_ = true;
+    long page = sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < kCounters && fast_; i++) {
+        if (fds_[i] < 0) continue;
+        void* p = mmap(nullptr, page, PROT_READ, MAP_SHARED, fds_[i], 0);
+        if (p == MAP_FAILED) {
+            fast_ = false;
+            break;
+        }
+        pages_[i] = p;
+        fast_ = ((perf_event_mmap_page*)p)->cap_user_rdpmc;
+    }
+#endif
+
+    ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+    error_ = "hardware counters need Linux perf_event_open";
+#endif
+}
+
+Utils::PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    long page = sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < kCounters; i++) {
+        if (pages_[i] != nullptr) munmap(pages_[i], page);
+        if (fds_[i] >= 0) close(fds_[i]);
+    }
+#endif
+}
+
+/**
+ * @brief Reads one counter, with rdpmc when the kernel exposes it.
+ *
+ * The rdpmc path follows the seqlock protocol of perf_event_mmap_page: if
+ * the kernel updates the page while we read, the read is retried. When the
+ * event is not currently on a hardware counter (index 0) it falls back to
+ * a read() syscall.
+ */
+uint64_t Utils::PerfCounters::ReadOne(int i) const {
+#ifdef __linux__
+    if (fds_[i] < 0) return 0;
+#ifdef UTILS_HAVE_RDPMC
+    if (fast_ && pages_[i] != nullptr) {
+        volatile perf_event_mmap_page* pc = (volatile perf_event_mmap_page*)pages_[i];
+        uint32_t seq, idx;
+        uint64_t count;
+        do {
+            seq = pc->lock;
+            __asm__ volatile("" ::: "memory");
+            idx = pc->index;
+            count = pc->offset;
+            if (idx != 0) {
+                uint16_t width = pc->pmc_width;
+                int64_t pmc = (int64_t)Rdpmc(idx - 1);
+                pmc <<= 64 - width;
+                pmc >>= 64 - width;
+                count += pmc;
+            }
+            __asm__ volatile("" ::: "memory");
+        } while (pc->lock != seq);
+        if (idx != 0) return count;
+    }
+#endif
+    uint64_t value = 0;
+    if (read(fds_[i], &value, sizeof(value)) != sizeof(value)) return 0;
+    return value;
+#else
+    (void)i;
+    return 0;
+#endif
+}
+
+Utils::PerfSample Utils::PerfCounters::Read() const {
+    PerfSample s;
+    if (!Available()) return s;
+    s.cycles = ReadOne(0);
+    s.instructions = ReadOne(1);
+    s.cache_misses = ReadOne(2);
+    s.branch_misses = ReadOne(3);
+    return s;
+}
+
+Utils::PerfCounters& Utils::ThreadPerfCounters() {
+    thread_local PerfCounters counters;
+    return counters;
+}
+
+double Utils::PerfRegionStats::Ipc() const {
+    return total.cycles ? (double)total.instructions / total.cycles : 0.0;
+}
+
+double Utils::PerfRegionStats::CacheMissesPerKiloInstr() const {
+    return total.instructions ? 1000.0 * total.cache_misses / total.instructions : 0.0;
+}
+
+double Utils::PerfRegionStats::BranchMissesPerKiloInstr() const {
+    return total.instructions ? 1000.0 * total.branch_misses / total.instructions : 0.0;
+}
+
+std::string Utils::PerfRegionStats::Summary() const {
+    double per_call = calls ? 1.0 / calls : 0.0;
+    return StrFmt(
+        "%s: %llu calls, %.0f cycles/call, %.0f instr/call, IPC %.2f, "
+        "cache-miss/kinstr %.2f, branch-miss/kinstr %.2f",
+        name, (unsigned long long)calls, total.cycles * per_call,
+        total.instructions * per_call, Ipc(), CacheMissesPerKiloInstr(),
+        BranchMissesPerKiloInstr());
+}
@@ -0,0 +1,108 @@
+/**
+ * cpputil
+ *
+ * Hardware performance counters for scoped regions. PreciseTime
+ * says how long something took; cycles, instructions, cache misses
+ * and branch misses say why. Linux only, through perf_event_open,
+ * with userspace rdpmc reads on x86 when the kernel allows them.
+ * Everywhere else, or when counters are not permitted, the counters
+ * report themselves unavailable and read as zero.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_PERFCOUNTERS_H__
+#define __UTILCPP_PERFCOUNTERS_H__
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+
+namespace Utils {
+
+struct PerfSample {
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t cache_misses = 0;
+    uint64_t branch_misses = 0;
+
+    PerfSample& operator+=(const PerfSample& o);
+    PerfSample operator-(const PerfSample& o) const;
+};
+
+// Counters for the calling thread, user space only. Construct and read
+// them on the same thread. Individual counters the PMU does not have
+// (cache misses on some VMs, for example) read as zero.
+class PerfCounters {
+   public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool Available() const { return fds_[0] >= 0; }
+
+    // Why the counters are unavailable, or empty.
+    const std::string& Error() const { return error_; }
+
+    // True when reads use the rdpmc instruction instead of a syscall.
+    bool FastReads() const { return fast_; }
+
+    PerfSample Read() const;
+
+   private:
+    static constexpr int kCounters = 4;
+
+    uint64_t ReadOne(int i) const;
+
+    int fds_[kCounters];
+    void* pages_[kCounters];
+    bool fast_ = false;
+    std::string error_;
+};
+
+// The calling thread's counters, opened on first use.
+PerfCounters& ThreadPerfCounters();
+
+// Counter totals for a named region of code.
+struct PerfRegionStats {
+    explicit PerfRegionStats(std::string n) : name(std::move(n)) {}
+
+    std::string name;
+    uint64_t calls = 0;
+    PerfSample total;
+
+    double Ipc() const;
+    double CacheMissesPerKiloInstr() const;
+    double BranchMissesPerKiloInstr() const;
+
+    // e.g. "update: 1000 calls, 812 cycles/call, IPC 2.31, ..."
+    std::string Summary() const;
+};
+
+// Adds the counter deltas of the enclosing scope to a region. The stats
+// object is not synchronized, so keep one per thread.
+class ScopedPerfRegion {
+   public:
+    explicit ScopedPerfRegion(PerfRegionStats& stats,
+                              PerfCounters& counters = ThreadPerfCounters())
+        : stats_(stats), counters_(counters), start_(counters.Read()) {}
+
+    ~ScopedPerfRegion() {
+        stats_.total += counters_.Read() - start_;
+        stats_.calls++;
+    }
+
+    ScopedPerfRegion(const ScopedPerfRegion&) = delete;
+    ScopedPerfRegion& operator=(const ScopedPerfRegion&) = delete;
+
+   private:
+    PerfRegionStats& stats_;
+    PerfCounters& counters_;
+    PerfSample start_;
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_PERFCOUNTERS_H__
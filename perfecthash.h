@@ -0,0 +1,226 @@
+/**
+ * cpputil
+ *
+ * Perfect hashing for key sets fixed at compile time, like command names
+ * and channel mnemonics. The table is built by the compiler, in the
+ * hash-and-displace style of CHD: keys are spread over buckets, and each
+ * bucket, largest first, gets the smallest displacement that moves all
+ * of its keys into free slots. There are exactly as many slots as keys.
+ * A lookup is one hash of the key, one table read for the displacement
+ * and one key compare, with no construction at startup and no heap.
+ *
+ *     #include "perfecthash.h"
+ *     #include "utils.h"  // MapGetOrDefault
+ *
+ *     constexpr auto kCommands = Utils::MakePerfectHashMap<std::string_view, int>(
+ *         {{"start", 1}, {"stop", 2}, {"status", 3}});
+ *     int id = Utils::MapGetOrDefault(kCommands, name, -1);
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_PERFECTHASH_H__
+#define __UTILCPP_PERFECTHASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "hashmap.h"
+
+namespace Utils {
+
+// Reads n <= 8 bytes as a little-endian word. Constant evaluation
+// cannot reinterpret memory, so it assembles the bytes one by one. At
+// run time, on a little-endian machine, the same word comes from at
+// most two loads: two overlapping 4-byte loads cover 4 to 7 bytes, and
+// the first, middle and last byte cover 1 to 3.
+constexpr uint64_t _perfect_load(const char* p, size_t n) {
+    uint64_t w = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (!__builtin_is_constant_evaluated()) {
+        if (n == 8) {
+            memcpy(&w, p, 8);
+        } else if (n >= 4) {
+            uint32_t lo = 0, hi = 0;
+            memcpy(&lo, p, 4);
+            memcpy(&hi, p + n - 4, 4);
+            w = lo | (uint64_t)hi << (8 * (n - 4));
+        } else if (n > 0) {
+            w = (uint64_t)(uint8_t)p[0] | (uint64_t)(uint8_t)p[n / 2] << (8 * (n / 2)) |
+                (uint64_t)(uint8_t)p[n - 1] << (8 * (n - 1));
+        }
+        return w;
+    }
+#endif
+    for (size_t b = 0; b < n; b++) w |= (uint64_t)(uint8_t)p[b] << (8 * b);
+    return w;
+}
+
+// A string hash that gives the same result at compile time and at run
+// time, with the rounds of HashBytes.
+constexpr uint64_t _perfect_hash(std::string_view s) {
+    const uint64_t k = 0xff51afd7ed558ccdull;
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ (s.size() * k);
+    size_t i = 0;
+    for (; i + 8 <= s.size(); i += 8) {
+        h = (h ^ (_perfect_load(s.data() + i, 8) * k)) * 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 29;
+    }
+    h = (h ^ (_perfect_load(s.data() + i, s.size() - i) * k)) * 0xc4ceb9fe1a85ec53ull;
+    return h ^ (h >> 32);
+}
+
+// Keys are strings (std::string_view, so they can live in a constexpr
+// table) or integers and enums.
+template <typename K, typename Q>
+constexpr uint64_t _perfect_key_hash(const Q& key) {
+    if constexpr (std::is_convertible<const Q&, std::string_view>::value)
+        return _perfect_hash(std::string_view(key));
+    else
+        return HashMix((uint64_t)key);
+}
+
+template <typename K, typename V, size_t N>
+class PerfectHashMap {
+    static_assert(N > 0, "PerfectHashMap needs at least one key");
+    static_assert(std::is_convertible<K, std::string_view>::value || std::is_integral<K>::value ||
+                      std::is_enum<K>::value,
+                  "PerfectHashMap keys are string_views, integers or enums");
+
+   public:
+    // std::pair is not assignable in a constant expression before C++20,
+    // so slots are a plain struct with the same member names.
+    struct value_type {
+        K first;
+        V second;
+    };
+    using key_type = K;
+    using mapped_type = V;
+    using size_type = size_t;
+    using const_iterator = const value_type*;
+    using iterator = const_iterator;
+
+    // Fails to compile, when evaluated as a constant, on a duplicate key.
+    constexpr explicit PerfectHashMap(const std::pair<K, V> (&entries)[N]) {
+        uint64_t hashes[N] = {};
+        size_t bucket_of[N] = {};
+        size_t count[kBuckets] = {};
+        for (size_t i = 0; i < N; i++) {
+            hashes[i] = _perfect_key_hash<K>(entries[i].first);
+            bucket_of[i] = Reduce(hashes[i], kBuckets);
+            count[bucket_of[i]]++;
+        }
+
+        // Keys grouped by bucket, and the buckets ordered largest first:
+        // the big ones are placed while the table is still empty.
+        size_t start[kBuckets + 1] = {};
+        for (size_t b = 0; b < kBuckets; b++) start[b + 1] = start[b] + count[b];
+        size_t members[N] = {};
+        size_t fill[kBuckets] = {};
+        for (size_t i = 0; i < N; i++) {
+            size_t b = bucket_of[i];
+            members[start[b] + fill[b]++] = i;
+        }
+        size_t largest = 0;
+        for (size_t b = 0; b < kBuckets; b++) largest = count[b] > largest ? count[b] : largest;
+        size_t order[kBuckets] = {};
+        size_t ordered = 0;
+        for (size_t c = largest; c > 0; c--)
+            for (size_t b = 0; b < kBuckets; b++)
+                if (count[b] == c) order[ordered++] = b;
+
+        bool taken[N] = {};
+        size_t slots[N] = {};
+        for (size_t o = 0; o < ordered; o++) {
+            const size_t b = order[o];
+            const size_t* keys = members + start[b];
+            // Keys with equal hashes share a bucket and land in the same
+            // slot whatever the displacement.
+            for (size_t k = 0; k < count[b]; k++) {
+                for (size_t m = 0; m < k; m++) {
+                    if (hashes[keys[m]] != hashes[keys[k]]) continue;
+                    if (entries[keys[m]].first == entries[keys[k]].first)
+                        throw std::logic_error("PerfectHashMap: duplicate key");
+                    throw std::logic_error("PerfectHashMap: hash collision");
+                }
+            }
+            uint32_t d = 0;
+            for (;; d++) {
+                if (d == kMaxDisplacement)
+                    throw std::logic_error("PerfectHashMap: no displacement found");
+                bool fits = true;
+                for (size_t k = 0; k < count[b] && fits; k++) {
+                    slots[k] = Slot(hashes[keys[k]], d);
+                    fits = !taken[slots[k]];
+                    for (size_t m = 0; m < k && fits; m++) fits = slots[m] != slots[k];
+                }
+                if (fits) break;
+            }
+            disp_[b] = d;
+            for (size_t k = 0; k < count[b]; k++) {
+                taken[slots[k]] = true;
+                slots_[slots[k]] = value_type{entries[keys[k]].first, entries[keys[k]].second};
+            }
+        }
+    }
+
+    constexpr size_t size() const { return N; }
+    constexpr bool empty() const { return false; }
+
+    // Iteration is in slot order, not in the order the keys were given.
+    constexpr const_iterator begin() const { return slots_; }
+    constexpr const_iterator end() const { return slots_ + N; }
+
+    // Any key is hashed to some slot, so a miss costs the same compare.
+    template <typename Q>
+    constexpr const_iterator find(const Q& key) const {
+        const uint64_t h = _perfect_key_hash<K>(key);
+        const size_t s = Slot(h, disp_[Reduce(h, kBuckets)]);
+        return slots_[s].first == key ? slots_ + s : end();
+    }
+    template <typename Q>
+    constexpr bool contains(const Q& key) const {
+        return find(key) != end();
+    }
+    template <typename Q>
+    constexpr size_t count(const Q& key) const {
+        return contains(key) ? 1 : 0;
+    }
+    template <typename Q>
+    constexpr const V& at(const Q& key) const {
+        auto it = find(key);
+        if (it == end()) throw std::out_of_range("PerfectHashMap::at");
+        return it->second;
+    }
+
+   private:
+    // About two keys per bucket keeps the displacement table small while
+    // the search for displacements stays short.
+    static constexpr size_t kBuckets = N / 2 + 1;
+    static constexpr uint32_t kMaxDisplacement = 1u << 20;
+
+    // Maps a hash onto [0, n) with a multiply instead of a division.
+    static constexpr size_t Reduce(uint64_t h, size_t n) {
+        return (size_t)(((__uint128_t)h * n) >> 64);
+    }
+    static constexpr size_t Slot(uint64_t h, uint32_t d) { return Reduce(HashMix(h ^ d), N); }
+
+    value_type slots_[N] = {};
+    uint32_t disp_[kBuckets] = {};
+};
+
+// Deduces the size from a braced list:
+//     constexpr auto m = MakePerfectHashMap<std::string_view, int>({{"a", 1}, {"b", 2}});
+template <typename K, typename V, size_t N>
+constexpr PerfectHashMap<K, V, N> MakePerfectHashMap(const std::pair<K, V> (&entries)[N]) {
+    return PerfectHashMap<K, V, N>(entries);
+}
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_PERFECTHASH_H__
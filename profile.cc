@@ -0,0 +1,117 @@
+/**
+ * cpputil
+ *
+ * Scoped timers and named instrumentation zones.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "profile.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+constexpr uint32_t kMaxZones = 1024;
+constexpr size_t kBufferEvents = 1024;
+
+struct Zone {
+    explicit Zone(const char* n) : name(n) {}
+    std::string name;
+    Utils::AtomicHistogram durations;
+};
+
+// Zones are never freed, so a thread exiting during shutdown can still
+// flush into them.
+std::atomic<Zone*> zones[kMaxZones + 1];
+std::atomic<uint32_t> zone_count{0};
+
+std::mutex& RegistryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::unordered_map<uint64_t, Zone*>& ZonesByKey() {
+    static std::unordered_map<uint64_t, Zone*> by_key;
+    return by_key;
+}
+
+// The zone for a site's key, created from the site's name the first time
+// any thread flushes it. nullptr once the registry is full.
+Zone* InternZone(const Utils::ZoneSite& site) {
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    auto& by_key = ZonesByKey();
+    auto it = by_key.find(site.key);
+    if (it != by_key.end()) return it->second;
+    Zone* z = nullptr;
+    uint32_t n = zone_count.load(std::memory_order_relaxed);
+    if (n < kMaxZones) {
+        z = new Zone(site.name);
+        zones[n + 1].store(z, std::memory_order_release);
+        zone_count.store(n + 1, std::memory_order_release);
+    }
+    by_key.emplace(site.key, z);
+    return z;
+}
+
+struct ZoneEvent {
+    const Utils::ZoneSite* site;
+    uint64_t start;
+    uint64_t end;
+};
+
+struct ZoneBuffer {
+    ZoneEvent events[kBufferEvents];
+    size_t size = 0;
+    // Zones this thread has flushed into before, so the registry lock
+    // is only taken for a key the thread has not seen.
+    std::unordered_map<uint64_t, Zone*> known;
+
+    ~ZoneBuffer() { Flush(); }
+
+    void Flush() {
+        for (size_t i = 0; i < size; i++) {
+            const Utils::ZoneSite* site = events[i].site;
+            auto it = known.find(site->key);
+            if (it == known.end()) it = known.emplace(site->key, InternZone(*site)).first;
+            if (it->second) it->second->durations.Record(events[i].end - events[i].start);
+        }
+        size = 0;
+    }
+};
+
+thread_local ZoneBuffer zone_buffer;
+
+}  // namespace
+
+void Utils::RecordZone(const ZoneSite& site, uint64_t start_ns, uint64_t end_ns) {
+    ZoneBuffer& b = zone_buffer;
+    b.events[b.size++] = ZoneEvent{&site, start_ns, end_ns};
+    if (b.size == kBufferEvents) b.Flush();
+}
+
+void Utils::FlushZones() { zone_buffer.Flush(); }
+
+void Utils::ForEachZone(
+    const std::function<void(const char* name, const AtomicHistogram&)>& f) {
+    uint32_t n = zone_count.load(std::memory_order_acquire);
+    for (uint32_t id = 1; id <= n; id++) {
+        Zone* z = zones[id].load(std::memory_order_acquire);
+        f(z->name.c_str(), z->durations);
+    }
+}
+
+std::string Utils::ZoneReport() {
+    std::string report;
+    ForEachZone([&](const char* name, const AtomicHistogram& h) {
+        report += StrFmt("%-32s %s\n", name, h.Summary(1000.0, "us"));
+    });
+    return report;
+}
+
+void Utils::ResetZones() {
+    uint32_t n = zone_count.load(std::memory_order_acquire);
+    for (uint32_t id = 1; id <= n; id++)
+        zones[id].load(std::memory_order_acquire)->durations.Reset();
+}
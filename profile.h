@@ -0,0 +1,119 @@
+/**
+ * cpputil
+ *
+ * Scoped timers and named instrumentation zones. Instead of wrapping
+ * code in pairs of PreciseTime calls and subtracting, put
+ *
+ *     UTILS_ZONE("control.update");
+ *
+ * at the top of a scope. Entry and exit times go into a per-thread
+ * buffer that is folded into one histogram per zone name, and show
+ * up as slices while a trace is recorded (see trace.h). Names are
+ * interned at compile time as a hash of the literal, so entering a zone
+ * is two clock reads and a buffer append, with no registration on first
+ * use. Defining UTILS_NO_INSTRUMENTATION compiles every zone away.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_PROFILE_H__
+#define __UTILCPP_PROFILE_H__
+
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+#include <string>
+
+#include "histogram.h"
+#include "trace.h"
+
+namespace Utils {
+
+// The clock used by instrumentation: the raw monotonic clock in ns. It
+// deliberately ignores the installed clock source, since a virtual clock
+// would make every zone take zero time.
+inline uint64_t ProfileNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// FNV-1a over a zone name. The UTILS_ZONE macro evaluates it at compile
+// time, so a zone is identified by a constant and nothing is looked up
+// or registered when a call site runs.
+constexpr uint64_t ZoneKey(const char* name) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (; *name; name++) h = (h ^ (uint8_t)*name) * 0x100000001b3ull;
+    return h;
+}
+
+// One per UTILS_ZONE call site, built entirely at compile time. Sites
+// with the same name have the same key and share a zone; names are
+// gathered from the sites when buffered intervals are flushed.
+struct ZoneSite {
+    constexpr ZoneSite(const char* n, const char* f, int l)
+        : name(n), file(f), line(l), key(ZoneKey(n)) {}
+
+    const char* name;
+    const char* file;
+    int line;
+    uint64_t key;
+};
+
+// Appends one timed interval to the calling thread's buffer.
+void RecordZone(const ZoneSite& site, uint64_t start_ns, uint64_t end_ns);
+
+// Times the enclosing scope into a zone, and records it as a trace
+// slice when a trace is running.
+class ScopedTimer {
+   public:
+    explicit ScopedTimer(const ZoneSite& site)
+        : site_(site), traced_(TraceEnabled() ? site.name : nullptr) {
+        if (traced_) TraceBegin(traced_);
+        start_ = ProfileNow();
+    }
+    ~ScopedTimer() {
+        RecordZone(site_, start_, ProfileNow());
+        if (traced_) TraceEnd(traced_);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+   private:
+    const ZoneSite& site_;
+    const char* traced_;
+    uint64_t start_;
+};
+
+// Folds the calling thread's buffered intervals into the zone
+// histograms. Buffers are also flushed when full and at thread exit, so
+// this is only needed before reading the zones from the same thread.
+void FlushZones();
+
+// Calls f for every zone seen so far with its duration histogram (ns).
+void ForEachZone(const std::function<void(const char* name, const AtomicHistogram&)>& f);
+
+// One line per zone, durations in microseconds.
+std::string ZoneReport();
+
+// Clears every zone histogram.
+void ResetZones();
+
+};  // namespace Utils
+
+#define UTILS_CONCAT_(a, b) a##b
+#define UTILS_CONCAT(a, b) UTILS_CONCAT_(a, b)
+
+#ifdef UTILS_NO_INSTRUMENTATION
+#define UTILS_ZONE(name) ((void)0)
+#else
+#define UTILS_ZONE(name)                                                    \
+    static constexpr ::Utils::ZoneSite UTILS_CONCAT(_utils_zone_site_,      \
+                                                    __LINE__){              \
+        name, __FILE__, __LINE__};                                          \
+    ::Utils::ScopedTimer UTILS_CONCAT(_utils_zone_, __LINE__)(              \
+        UTILS_CONCAT(_utils_zone_site_, __LINE__))
+#endif
+
+#endif  // __UTILCPP_PROFILE_H__
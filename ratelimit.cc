@@ -0,0 +1,176 @@
+/**
+ * cpputil
+ *
+ * Lock-free token bucket rate limiters.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "ratelimit.h"
+
+#include <algorithm>
+#include <thread>
+
+int64_t Utils::TokenBucket::NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               Now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief Creates a bucket that starts out full.
+ *
+ * @param rate Tokens added per second.
+ * @param burst The most tokens the bucket can hold. At least one.
+ */
+Utils::TokenBucket::TokenBucket(double rate, double burst)
+    : interval_(std::max<int64_t>(1, (int64_t)(1e9 / rate))),
+      capacity_((int64_t)(std::max(burst, 1.0) * interval_)),
+      tat_(NowNs()) {}
+
+int64_t Utils::TokenBucket::Reserve(uint32_t n, int64_t now, int64_t max_wait) {
+    const int64_t cost = (int64_t)n * interval_;
+    int64_t tat = tat_.load(std::memory_order_relaxed);
+    for (;;) {
+        int64_t next = std::max(tat, now) + cost;
+        int64_t wait = next - now - capacity_;
+        if (wait > max_wait) return -1;
+        if (tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed))
+            return std::max<int64_t>(wait, 0);
+    }
+}
+
+uint32_t Utils::TokenBucket::TakeUpTo(uint32_t n, int64_t now) {
+    int64_t tat = tat_.load(std::memory_order_relaxed);
+    for (;;) {
+        int64_t base = std::max(tat, now);
+        int64_t available = (capacity_ - (base - now)) / interval_;
+        if (available <= 0) return 0;
+        uint32_t take = (uint32_t)std::min<int64_t>(n, available);
+        if (tat_.compare_exchange_weak(tat, base + (int64_t)take * interval_,
+                                       std::memory_order_relaxed))
+            return take;
+    }
+}
+
+bool Utils::TokenBucket::TryAcquire(uint32_t n) {
+    return Reserve(n, NowNs(), 0) >= 0;
+}
+
+/**
+ * @brief Takes tokens, waiting for them if necessary.
+ *
+ * The tokens are reserved up front, before sleeping, so a later caller
+ * cannot take them in the meantime.
+ *
+ * @param n The number of tokens to take.
+ * @param deadline The latest time the caller is willing to wait until.
+ *
+ * @return True if the tokens were taken, false if the deadline would
+ * have passed first. Nothing is taken in that case.
+ */
+bool Utils::TokenBucket::AcquireUntil(
+    uint32_t n, std::chrono::high_resolution_clock::time_point deadline) {
+    int64_t now = NowNs();
+    int64_t limit = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        deadline.time_since_epoch())
+                        .count() -
+                    now;
+    if (limit < 0) limit = 0;
+    int64_t wait = Reserve(n, now, limit);
+    if (wait < 0) return false;
+    if (wait > 0) SleepFor(std::chrono::nanoseconds(wait));
+    return true;
+}
+
+double Utils::TokenBucket::Available() const {
+    int64_t now = NowNs();
+    int64_t debt = std::max(tat_.load(std::memory_order_relaxed), now) - now;
+    return std::max<int64_t>(capacity_ - debt, 0) / (double)interval_;
+}
+
+Utils::ShardedTokenBucket::ShardedTokenBucket(double rate, double burst,
+                                              unsigned shards) {
+    if (shards == 0) shards = std::max(1u, std::thread::hardware_concurrency());
+    // A shard cannot hold less than one token, so more shards than
+    // tokens would inflate the burst.
+    unsigned most = (unsigned)std::min<double>(std::max(burst, 1.0), kMaxShards);
+    shards = std::min(shards, most);
+    for (unsigned i = 0; i < shards; i++)
+        shards_.push_back(std::make_unique<TokenBucket>(rate / shards, burst / shards));
+}
+
+unsigned Utils::ShardedTokenBucket::Home() const {
+    static std::atomic<unsigned> next_thread{0};
+    thread_local unsigned index = next_thread.fetch_add(1, std::memory_order_relaxed);
+    return index % shards_.size();
+}
+
+/**
+ * @brief Takes n tokens if the shards hold that many between them.
+ *
+ * The calling thread's own shard is tried first, then the others one at
+ * a time. If no single shard has n tokens, whatever each holds is
+ * gathered, and given back if the total falls short.
+ */
+bool Utils::ShardedTokenBucket::TryAcquire(uint32_t n) {
+    const unsigned count = shards_.size();
+    unsigned home = Home();
+    for (unsigned i = 0; i < count; i++)
+        if (shards_[(home + i) % count]->TryAcquire(n)) return true;
+    if (count == 1 || n <= 1) return false;
+
+    int64_t now = TokenBucket::NowNs();
+    uint32_t taken[kMaxShards] = {};
+    uint32_t total = 0;
+    for (unsigned i = 0; i < count && total < n; i++) {
+        taken[i] = shards_[(home + i) % count]->TakeUpTo(n - total, now);
+        total += taken[i];
+    }
+    if (total == n) return true;
+    for (unsigned i = 0; i < count; i++)
+        if (taken[i] > 0) shards_[(home + i) % count]->Refund(taken[i]);
+    return false;
+}
+
+/**
+ * @brief Takes n tokens, waiting for them if necessary.
+ *
+ * If they are not available right away, an equal share of n is reserved
+ * from every shard, so the wait is that of one bucket with the full
+ * rate. Nothing is taken if any share would be late for the deadline.
+ */
+bool Utils::ShardedTokenBucket::AcquireUntil(
+    uint32_t n, std::chrono::high_resolution_clock::time_point deadline) {
+    if (TryAcquire(n)) return true;
+
+    const unsigned count = shards_.size();
+    int64_t now = TokenBucket::NowNs();
+    int64_t limit = std::max<int64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch())
+                .count() -
+            now,
+        0);
+    int64_t longest = 0;
+    for (unsigned i = 0; i < count; i++) {
+        uint32_t share = n / count + (i < n % count ? 1 : 0);
+        if (share == 0) continue;
+        int64_t wait = shards_[i]->Reserve(share, now, limit);
+        if (wait < 0) {
+            for (unsigned j = 0; j < i; j++) {
+                uint32_t given = n / count + (j < n % count ? 1 : 0);
+                if (given > 0) shards_[j]->Refund(given);
+            }
+            return false;
+        }
+        longest = std::max(longest, wait);
+    }
+    if (longest > 0) SleepFor(std::chrono::nanoseconds(longest));
+    return true;
+}
+
+double Utils::ShardedTokenBucket::Available() const {
+    double total = 0;
+    for (const auto& shard : shards_) total += shard->Available();
+    return total;
+}
@@ -0,0 +1,108 @@
+/**
+ * cpputil
+ *
+ * Lock-free token bucket rate limiters for throttling work shared
+ * by several threads, as opposed to pacing one loop the way
+ * ScheduleRate and RateLoop do.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_RATELIMIT_H__
+#define __UTILCPP_RATELIMIT_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "utils.h"
+
+namespace Utils {
+
+// A token bucket refilled at rate tokens per second and holding at most
+// burst tokens. The whole state is one 64-bit word: the time at which
+// the bucket will next be full (the "theoretical arrival time" of the
+// generic cell rate algorithm). The tokens available are implied by how
+// far that time is ahead of now, so acquiring is a single CAS and there
+// is no separate refill step. Time comes from the installed clock
+// source.
+class alignas(64) TokenBucket {
+   public:
+    TokenBucket(double rate, double burst);
+
+    // Takes n tokens if they are available right now.
+    bool TryAcquire(uint32_t n = 1);
+
+    // Takes n tokens, sleeping until they are available. Gives up without
+    // taking anything if that would be later than the deadline. Waiting
+    // callers are served in the order they arrive.
+    bool AcquireUntil(uint32_t n, std::chrono::high_resolution_clock::time_point deadline);
+
+    template <typename Rep, typename Period>
+    bool AcquireFor(uint32_t n, std::chrono::duration<Rep, Period> timeout) {
+        return AcquireUntil(
+            n, Now() + std::chrono::duration_cast<
+                           std::chrono::high_resolution_clock::duration>(timeout));
+    }
+
+    // The number of tokens that could be taken right now.
+    double Available() const;
+
+    double Rate() const { return 1e9 / interval_; }
+    double Burst() const { return (double)capacity_ / interval_; }
+
+   private:
+    friend class ShardedTokenBucket;
+
+    // Reserves n tokens, allowing the bucket to go up to max_wait into
+    // debt. Returns the wait in ns, or -1 if that is more than allowed.
+    int64_t Reserve(uint32_t n, int64_t now, int64_t max_wait);
+
+    // Takes as many whole tokens as are available, up to n, and returns
+    // how many it took.
+    uint32_t TakeUpTo(uint32_t n, int64_t now);
+
+    // Gives back n tokens taken or reserved earlier.
+    void Refund(uint32_t n) { tat_.fetch_sub((int64_t)n * interval_, std::memory_order_relaxed); }
+
+    static int64_t NowNs();
+
+    int64_t interval_;  // ns per token
+    int64_t capacity_;  // ns worth of tokens when full (burst * interval)
+    std::atomic<int64_t> tat_;
+};
+
+// A rate limiter split into per-thread shards, each with an equal share
+// of the rate and burst. Threads take from their own shard and only
+// touch the others when it is empty, so under heavy contention the CAS
+// traffic stays on mostly private cache lines. The total rate and burst
+// are those configured. A request larger than one shard holds is served
+// by gathering tokens from all of them, and a wait is spread over all
+// shards so that it runs at the full rate.
+class ShardedTokenBucket {
+   public:
+    static constexpr unsigned kMaxShards = 64;
+
+    // Zero shards means one per hardware thread. No more than burst
+    // shards are used, so that each can hold at least one token, and no
+    // more than kMaxShards.
+    ShardedTokenBucket(double rate, double burst, unsigned shards = 0);
+
+    bool TryAcquire(uint32_t n = 1);
+    bool AcquireUntil(uint32_t n, std::chrono::high_resolution_clock::time_point deadline);
+    double Available() const;
+
+    unsigned Shards() const { return shards_.size(); }
+
+   private:
+    unsigned Home() const;
+
+    // Separate allocations; TokenBucket is cache-line aligned.
+    std::vector<std::unique_ptr<TokenBucket>> shards_;
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_RATELIMIT_H__
@@ -0,0 +1,181 @@
+/**
+ * cpputil
+ *
+ * Thread pinning, real-time priority, memory locking and a
+ * drift-free rate loop.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "realtime.h"
+
+#include "trace.h"
+#include "watchdog.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <alloca.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTILS_CPU_RELAX() _mm_pause()
+#else
+#define UTILS_CPU_RELAX() ((void)0)
+#endif
+
+std::string Utils::ThreadConfigResult::Summary() const {
+    std::string s = pinned ? StrFmt("cpu=%d", cpu) : "cpu=any";
+    s += realtime ? StrFmt(" fifo=%d", priority) : " fifo=off";
+    s += memory_locked ? " mlock=on" : " mlock=off";
+    s += StrFmt(" stack=%zu", stack_prefaulted);
+    for (const auto& n : notes) s += " (" + n + ")";
+    return s;
+}
+
+/**
+ * @brief Touches a region of the current thread's stack.
+ *
+ * The pages are written once so that page faults happen now and not in
+ * the middle of a control loop iteration. Combined with mlockall the
+ * pages then stay resident.
+ *
+ * @param bytes The number of bytes of stack to prefault.
+ */
+__attribute__((noinline)) void Utils::PrefaultStack(size_t bytes) {
+#ifdef __linux__
+    volatile char* p = (volatile char*)alloca(bytes);
+    for (size_t i = 0; i < bytes; i += 4096) p[i] = 0;
+    if (bytes > 0) p[bytes - 1] = 0;
+#else
+    (void)bytes;
+#endif
+}
+
+/**
+ * @brief Applies CPU affinity, scheduling priority and memory locking to
+ * the calling thread.
+ *
+ * Each setting is tried independently. A setting that cannot be applied
+ * does not stop the others; the returned result says what took effect. In
+ * particular, without CAP_SYS_NICE (or an rtprio rlimit) SCHED_FIFO is
+ * refused and the thread stays on the normal scheduler.
+ *
+ * @param config The settings to apply.
+ *
+ * @return The settings that actually took effect, with notes on failures.
+ */
+Utils::ThreadConfigResult Utils::ConfigureCurrentThread(
+    const ThreadConfig& config) {
+    ThreadConfigResult result;
+#ifdef __linux__
+    if (config.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(config.cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err == 0) {
+            result.pinned = true;
+            result.cpu = config.cpu;
+        } else {
+            result.notes.push_back(
+                StrFmt("affinity to cpu %d failed: %s", config.cpu, strerror(err)));
+        }
+    }
+
+    if (config.priority > 0) {
+        int lo = sched_get_priority_min(SCHED_FIFO);
+        int hi = sched_get_priority_max(SCHED_FIFO);
+        sched_param param{};
+        param.sched_priority = Clamp(config.priority, hi, lo);
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err == 0) {
+            result.realtime = true;
+            result.priority = param.sched_priority;
+        } else {
+            result.notes.push_back(
+                StrFmt("SCHED_FIFO refused: %s", strerror(err)));
+            // Fall back to the best nice value we are allowed.
+            struct rlimit rl;
+            int nice_floor = 0;
+            if (getrlimit(RLIMIT_NICE, &rl) == 0)
+                nice_floor = rl.rlim_cur == RLIM_INFINITY ? -20 : 20 - (int)rl.rlim_cur;
+            if (nice_floor < 0 &&
+                setpriority(PRIO_PROCESS, 0, std::max(nice_floor, -20)) == 0)
+                result.notes.push_back(StrFmt("using nice %d", nice_floor));
+        }
+    }
+
+    if (config.lock_memory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            result.memory_locked = true;
+        } else {
+            result.notes.push_back(StrFmt("mlockall failed: %s", strerror(errno)));
+        }
+    }
+#else
+    if (config.cpu >= 0 || config.priority > 0 || config.lock_memory)
+        result.notes.push_back("thread configuration not supported here");
+#endif
+
+    if (config.prefault_stack > 0) {
+        PrefaultStack(config.prefault_stack);
+        result.stack_prefaulted = config.prefault_stack;
+    }
+    return result;
+}
+
+Utils::RateLoop::RateLoop(double rate_hz)
+    : period_(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::duration<double>(1.0 / rate_hz))) {
+    next_ = last_ = Now();
+}
+
+Utils::RateLoop::RateLoop(double rate_hz, const ThreadConfig& config)
+    : RateLoop(rate_hz) {
+    config_ = ConfigureCurrentThread(config);
+    next_ = last_ = Now();
+}
+
+/**
+ * @brief Sleeps until the next period boundary.
+ *
+ * Deadlines are absolute (the previous deadline plus one period), so time
+ * spent in the loop body does not accumulate as drift. On an overrun the
+ * loop does not sleep at all and the next deadline is one period from now.
+ *
+ * @return The time elapsed since the previous call returned, in seconds.
+ */
+double Utils::RateLoop::Wait() {
+    ClockSource& clock = GetClockSource();
+    if (trace_open_) TraceEnd(trace_name_);
+    next_ += std::chrono::duration_cast<time_point::duration>(period_);
+    time_point now = clock.Now();
+    if (now >= next_) {
+        overruns_++;
+        next_ = now;
+        if (trace_name_ != nullptr) TraceInstant("RateLoop overrun");
+    } else if (spin_.count() > 0 &&
+               dynamic_cast<SystemClock*>(&clock) != nullptr) {
+        clock.SleepUntil(next_ - std::chrono::duration_cast<time_point::duration>(spin_));
+        while (clock.Now() < next_) UTILS_CPU_RELAX();
+    } else {
+        clock.SleepUntil(next_);
+    }
+    iterations_++;
+    if (heartbeat_ != nullptr) heartbeat_->Beat();
+    trace_open_ = trace_name_ != nullptr && TraceEnabled();
+    if (trace_open_) TraceBegin(trace_name_);
+    time_point woke = clock.Now();
+    double dt = std::chrono::duration<double>(woke - last_).count();
+    last_ = woke;
+    return dt;
+}
@@ -0,0 +1,117 @@
+/**
+ * cpputil
+ *
+ * Helpers for making control loops deterministic: CPU pinning,
+ * real-time scheduling priority, memory locking and stack
+ * prefaulting, plus a drift-free rate loop that applies them.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_REALTIME_H__
+#define __UTILCPP_REALTIME_H__
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+namespace Utils {
+
+class Heartbeat;
+
+// What to change about the calling thread. Every field left at its
+// default is left alone.
+struct ThreadConfig {
+    int cpu = -1;                  // pin to this CPU, -1 to not pin
+    int priority = 0;              // SCHED_FIFO priority 1-99, 0 to not change
+    bool lock_memory = false;      // mlockall current and future pages
+    size_t prefault_stack = 0;     // bytes of stack to touch up front
+};
+
+// What actually took effect. Anything that was requested but could not
+// be applied (missing permissions, unsupported platform) is explained
+// in notes, and the thread keeps running with what it had.
+struct ThreadConfigResult {
+    bool pinned = false;
+    int cpu = -1;
+    bool realtime = false;
+    int priority = 0;
+    bool memory_locked = false;
+    size_t stack_prefaulted = 0;
+    std::vector<std::string> notes;
+
+    // A one line description, handy for LogFmt.
+    std::string Summary() const;
+};
+
+// Applies the configuration to the calling thread.
+ThreadConfigResult ConfigureCurrentThread(const ThreadConfig& config);
+
+// Touches the given number of bytes of stack so the pages are
+// resident before the time critical part of the thread starts.
+void PrefaultStack(size_t bytes);
+
+// Paces a loop at a fixed rate using absolute deadlines, so that unlike
+// ScheduleRate the period does not drift with the time spent in the
+// loop body. Sleeps go through the installed clock source.
+//
+//     Utils::ThreadConfig cfg;
+//     cfg.cpu = 3; cfg.priority = 80; cfg.lock_memory = true;
+//     Utils::RateLoop loop(100.0, cfg);
+//     while (running) { double dt = loop.Wait(); ... }
+class RateLoop {
+   public:
+    explicit RateLoop(double rate_hz);
+
+    // Also configures the calling thread, which should be the thread
+    // that runs the loop.
+    RateLoop(double rate_hz, const ThreadConfig& config);
+
+    // Sleeps until the start of the next period and returns the time in
+    // seconds since the previous call returned. If the deadline has
+    // already passed the overrun is counted and the schedule restarts
+    // from now instead of trying to catch up.
+    double Wait();
+
+    // Wakes this long before each deadline and busy-waits the rest, which
+    // trades CPU time for wakeup jitter. Only used with the real clock.
+    void SetSpin(std::chrono::nanoseconds spin) { spin_ = spin; }
+
+    // Beats the given watchdog heartbeat on every call to Wait().
+    void SetHeartbeat(Heartbeat* heartbeat) { heartbeat_ = heartbeat; }
+
+    // While a trace is running, records each iteration as a slice with
+    // this name and each overrun as an instant event. The name must
+    // outlive the trace, e.g. a string literal.
+    void SetTraceName(const char* name) { trace_name_ = name; }
+
+    uint64_t Iterations() const { return iterations_; }
+    uint64_t Overruns() const { return overruns_; }
+    std::chrono::nanoseconds Period() const { return period_; }
+    const ThreadConfigResult& Config() const { return config_; }
+
+    // The deadline the last call to Wait() slept until (or now, if that
+    // call overran).
+    std::chrono::high_resolution_clock::time_point Deadline() const { return next_; }
+
+   private:
+    using time_point = std::chrono::high_resolution_clock::time_point;
+
+    std::chrono::nanoseconds period_;
+    std::chrono::nanoseconds spin_{0};
+    time_point next_;
+    time_point last_;
+    uint64_t iterations_ = 0;
+    uint64_t overruns_ = 0;
+    Heartbeat* heartbeat_ = nullptr;
+    const char* trace_name_ = nullptr;
+    bool trace_open_ = false;
+    ThreadConfigResult config_;
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_REALTIME_H__
@@ -0,0 +1,50 @@
+/**
+ * cpputil
+ *
+ * Tests for the config file parser and its value parsers.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "../configparse.h"
+#include "../utils.h"
+#include "test.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+TEST(ParseDoubleSigns) {
+    double v = 0;
+    CHECK(Utils::ConfigParseDouble("+1.5", &v) && v == 1.5);
+    CHECK(Utils::ConfigParseDouble("-2", &v) && v == -2);
+    v = 7;
+    CHECK(!Utils::ConfigParseDouble("+-5", &v));
+    CHECK(!Utils::ConfigParseDouble("+", &v));
+    CHECK(!Utils::ConfigParseDouble("--5", &v));
+    CHECK(v == 7);
+}
+
+TEST(ParseIntSigns) {
+    int64_t v = 0;
+    CHECK(Utils::ConfigParseInt("+0x10", &v) && v == 16);
+    CHECK(Utils::ConfigParseInt("-9223372036854775808", &v) && v == INT64_MIN);
+    CHECK(!Utils::ConfigParseInt("+-5", &v));
+    CHECK(!Utils::ConfigParseInt("9223372036854775808", &v));
+}
+
+#ifdef __linux__
+// A pipe cannot be sized, and must fail rather than ask for a buffer of
+// SIZE_MAX bytes.
+TEST(ReadPipeFails) {
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    CHECK(write(fds[1], "a = 1\n", 6) == 6);
+    Utils::ConfigFile f;
+    CHECK(!f.Read(Utils::StrFmt("/proc/self/fd/%d", fds[0])));
+    close(fds[0]);
+    close(fds[1]);
+}
+#endif
+
+TEST_MAIN()
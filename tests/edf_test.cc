@@ -0,0 +1,54 @@
+/**
+ * cpputil
+ *
+ * Tests for the earliest-deadline-first scheduler.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include <stdexcept>
+
+#include "../edf.h"
+#include "test.h"
+
+using namespace std::chrono_literals;
+
+// A throwing job must not take the worker down or leave Drain waiting.
+TEST(ThrowingJobIsCountedAsFailed) {
+    Utils::EdfScheduler sched(1);
+    sched.SubmitIn([] { throw std::runtime_error("boom"); }, 1s);
+    int ran = 0;
+    sched.SubmitIn([&] { ran++; }, 2s);
+    sched.Drain();
+    auto stats = sched.GetStats();
+    CHECK(ran == 1);
+    CHECK(stats.failed == 1);
+    CHECK(stats.completed == 1);
+}
+
+// An urgent job that throws from a preemption point leaves the job it
+// preempted able to keep running and to be preempted again.
+TEST(ThrowFromPreemptionPoint) {
+    Utils::EdfScheduler sched(1);
+    bool first = false, second = false, after = false;
+    sched.SubmitIn(
+        [&] {
+            sched.SubmitIn([] { throw std::runtime_error("urgent"); }, 1s);
+            first = Utils::EdfScheduler::PreemptionPoint();
+            int urgent = 0;
+            sched.SubmitIn([&] { urgent++; }, 1s);
+            second = Utils::EdfScheduler::PreemptionPoint() && urgent == 1;
+            after = true;
+        },
+        1h);
+    sched.Drain();
+    auto stats = sched.GetStats();
+    CHECK(first);
+    CHECK(second);
+    CHECK(after);
+    CHECK(stats.failed == 1);
+    CHECK(stats.completed == 2);
+    CHECK(stats.preempted == 2);
+}
+
+TEST_MAIN()
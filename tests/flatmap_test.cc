@@ -0,0 +1,65 @@
+/**
+ * cpputil
+ *
+ * Tests for the flat sorted map.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "../flatmap.h"
+#include "../utils.h"
+#include "test.h"
+
+// bool values must not end up in a std::vector<bool>, whose proxies
+// cannot be handed out as bool&.
+TEST(BoolValues) {
+    Utils::FlatMap<std::string, bool> flags{{"a", true}, {"b", false}};
+    CHECK(Utils::MapGetOrDefault(flags, std::string_view("a"), false));
+    CHECK(!Utils::MapGetOrDefault(flags, std::string_view("b"), true));
+    CHECK(Utils::MapGetOrDefault(flags, std::string_view("c"), true));
+    flags["c"] = true;
+    flags.at("b") = true;
+    int set = 0;
+    for (const auto& [name, on] : flags) set += on ? 1 : 0;
+    CHECK(set == 3);
+    for (auto&& kv : flags) kv.second = false;
+    CHECK(!flags.at("a"));
+    const auto& cflags = flags;
+    const bool& a = cflags.at("a");
+    CHECK(!a);
+}
+
+namespace {
+
+// Throws when built from a negative number.
+struct Picky {
+    explicit Picky(int v) : value(v) {
+        if (v < 0) throw std::invalid_argument("negative");
+    }
+    int value;
+};
+
+}  // namespace
+
+TEST(TryEmplaceThrowLeavesMapUnchanged) {
+    Utils::FlatMap<std::string, Picky> m;
+    m.try_emplace("a", 1);
+    m.try_emplace("c", 3);
+    bool threw = false;
+    try {
+        m.try_emplace("b", -1);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(m.size() == 2);
+    CHECK(m.keys().size() == m.values().size());
+    CHECK(!m.contains("b"));
+    CHECK(m.at("c").value == 3);
+}
+
+TEST_MAIN()
@@ -0,0 +1,48 @@
+/**
+ * cpputil
+ *
+ * Tests for the open-addressing hash map.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include <stdexcept>
+#include <string>
+
+#include "../hashmap.h"
+#include "test.h"
+
+namespace {
+
+// Throws when built from a negative number.
+struct Picky {
+    explicit Picky(int v) : value(v) {
+        if (v < 0) throw std::invalid_argument("negative");
+    }
+    int value;
+};
+
+}  // namespace
+
+// A slot whose construction throws must not be left marked full.
+TEST(TryEmplaceThrowLeavesMapUnchanged) {
+    Utils::HashMap<std::string, Picky> m;
+    m.try_emplace("a", 1);
+    bool threw = false;
+    try {
+        m.try_emplace("b", -1);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(m.size() == 1);
+    CHECK(!m.contains("b"));
+    m.try_emplace("b", 2);
+    CHECK(m.at("b").value == 2);
+    // Enough more to grow the table over the slot that threw.
+    for (int i = 0; i < 100; i++) m.try_emplace(std::to_string(i), i);
+    CHECK(m.size() == 102);
+    CHECK(m.at("a").value == 1);
+}
+
+TEST_MAIN()
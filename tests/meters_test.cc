@@ -0,0 +1,62 @@
+/**
+ * cpputil
+ *
+ * Tests for the sliding-window counters and rate meters.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "../meters.h"
+#include "../utils.h"
+#include "test.h"
+
+using namespace std::chrono_literals;
+
+// A virtual clock starts at its epoch, so the window reaches back to
+// seconds before time zero.
+TEST(SlidingWindowNearEpoch) {
+    Utils::VirtualClock clock;
+    Utils::ScopedClockSource scoped(&clock);
+    clock.Advance(3s);
+    Utils::SlidingWindowCounter counter;
+    counter.Add(5);
+    CHECK(counter.Count(60s) == 5);
+    CHECK(counter.Count(0s) == 5);
+    clock.Advance(1500ms);
+    counter.Add(1);
+    CHECK(counter.Count(60s) == 6);
+    CHECK(counter.Count(0s) == 1);
+    // 6 events over the 4.5 s since the epoch, not over a minute.
+    double rate = counter.Rate(60s);
+    CHECK(rate > 1.3 && rate < 1.4);
+}
+
+// A clock set before its epoch counts into second 0 instead of indexing
+// the buckets with a negative second.
+TEST(SlidingWindowBeforeEpoch) {
+    Utils::VirtualClock clock;
+    Utils::ScopedClockSource scoped(&clock);
+    clock.Set(Utils::VirtualClock::time_point(-5s));
+    Utils::SlidingWindowCounter counter;
+    counter.Add(2);
+    CHECK(counter.Count(60s) == 2);
+    clock.Set(Utils::VirtualClock::time_point(500ms));
+    counter.Add(1);
+    CHECK(counter.Count(0s) == 3);
+    CHECK(counter.Rate(60s) > 0);
+}
+
+TEST(SlidingWindowExpires) {
+    Utils::VirtualClock clock(Utils::VirtualClock::time_point(100s));
+    Utils::ScopedClockSource scoped(&clock);
+    Utils::SlidingWindowCounter counter;
+    counter.Add(10);
+    clock.Advance(5s);
+    counter.Add(1);
+    CHECK(counter.Count(10s) == 11);
+    CHECK(counter.Count(2s) == 1);
+    clock.Advance(70s);
+    CHECK(counter.Count(60s) == 0);
+}
+
+TEST_MAIN()
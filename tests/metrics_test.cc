@@ -0,0 +1,54 @@
+/**
+ * cpputil
+ *
+ * Tests for the metrics registry and exporters.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "../metrics.h"
+#include "test.h"
+
+TEST(HelpIsEscaped) {
+    Utils::MetricsRegistry registry;
+    registry.Counter("jobs_total", "Jobs run.\nSee C:\\jobs", "");
+    std::string text = registry.Expose();
+    CHECK(text.find("# HELP jobs_total Jobs run.\\nSee C:\\\\jobs\n") != std::string::npos);
+    CHECK(text.find("# TYPE jobs_total counter\n") != std::string::npos);
+}
+
+// Explicit writes racing the exporter thread must each leave a whole file.
+TEST(ConcurrentWriteNow) {
+    Utils::MetricsRegistry registry;
+    registry.Gauge("level", "A level.", "").Set(1.5);
+    std::string path = "/tmp/cpputil_metrics_test_" + std::to_string(getpid()) + ".prom";
+    const std::string expected = registry.Expose();
+    std::atomic<int> failed{0};
+    {
+        Utils::MetricsFileExporter exporter(registry, path, std::chrono::milliseconds(1));
+        std::vector<std::thread> writers;
+        for (int t = 0; t < 4; t++)
+            writers.emplace_back([&] {
+                for (int i = 0; i < 200; i++)
+                    if (!exporter.WriteNow()) failed++;
+            });
+        for (auto& w : writers) w.join();
+    }
+    std::ifstream in(path);
+    std::stringstream text;
+    text << in.rdbuf();
+    CHECK(failed == 0);
+    CHECK(text.str() == expected);
+    remove(path.c_str());
+}
+
+TEST_MAIN()
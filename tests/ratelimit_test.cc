@@ -0,0 +1,66 @@
+/**
+ * cpputil
+ *
+ * Tests for the token bucket rate limiters.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include <cmath>
+
+#include "../ratelimit.h"
+#include "test.h"
+
+using namespace std::chrono_literals;
+
+// The clock only moves when told to, so a full bucket stays exactly full.
+TEST(TokenBucketBurstAndRefill) {
+    Utils::VirtualClock clock(Utils::VirtualClock::time_point(10s));
+    Utils::ScopedClockSource scoped(&clock);
+    Utils::TokenBucket bucket(100, 10);
+    CHECK(bucket.TryAcquire(10));
+    CHECK(!bucket.TryAcquire(1));
+    clock.Advance(50ms);
+    CHECK(bucket.TryAcquire(5));
+    CHECK(!bucket.TryAcquire(1));
+}
+
+// More shards than tokens: requests bigger than one shard's share must
+// still be served, and the burst must not grow.
+TEST(ShardedBurstSmallerThanShards) {
+    Utils::VirtualClock clock(Utils::VirtualClock::time_point(10s));
+    Utils::ScopedClockSource scoped(&clock);
+    Utils::ShardedTokenBucket bucket(100, 10, 16);
+    CHECK(bucket.Shards() <= 10);
+    CHECK(std::fabs(bucket.Available() - 10.0) < 1e-6);
+    CHECK(bucket.TryAcquire(2));
+    CHECK(bucket.TryAcquire(8));
+    CHECK(!bucket.TryAcquire(1));
+    CHECK(bucket.Available() < 1e-6);
+}
+
+TEST(ShardedGatherGivesBackOnShortfall) {
+    Utils::VirtualClock clock(Utils::VirtualClock::time_point(10s));
+    Utils::ScopedClockSource scoped(&clock);
+    Utils::ShardedTokenBucket bucket(100, 8, 4);
+    CHECK(!bucket.TryAcquire(9));
+    CHECK(std::fabs(bucket.Available() - 8.0) < 1e-6);
+    CHECK(bucket.TryAcquire(8));
+}
+
+// A wait for more than one shard holds runs at the full rate: 5 tokens
+// at 100 per second take 50 ms, not 50 ms times the shard count.
+TEST(ShardedAcquireUntilFullRate) {
+    Utils::VirtualClock clock(Utils::VirtualClock::time_point(10s));
+    Utils::ScopedClockSource scoped(&clock);
+    Utils::ShardedTokenBucket bucket(100, 10, 5);
+    CHECK(bucket.TryAcquire(10));
+    auto start = Utils::Now();
+    CHECK(!bucket.AcquireUntil(5, start + 20ms));
+    CHECK(Utils::Now() == start);
+    CHECK(bucket.AcquireUntil(5, start + 60ms));
+    auto waited = Utils::Now() - start;
+    CHECK(waited >= 50ms && waited <= 60ms);
+}
+
+TEST_MAIN()
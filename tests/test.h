@@ -0,0 +1,74 @@
+/**
+ * cpputil
+ *
+ * A minimal harness for the cpputil regression tests. Each test program
+ * registers cases with TEST, checks conditions with CHECK, and exits
+ * non-zero if any check failed, so `make test` stops at the first
+ * broken program.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_TEST_H__
+#define __UTILCPP_TEST_H__
+
+#include <stdio.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Test {
+
+struct Case {
+    const char* name;
+    std::function<void()> body;
+};
+
+inline std::vector<Case>& Cases() {
+    static std::vector<Case> cases;
+    return cases;
+}
+
+inline int& Failures() {
+    static int failures = 0;
+    return failures;
+}
+
+struct Register {
+    Register(const char* name, std::function<void()> body) {
+        Cases().push_back({name, std::move(body)});
+    }
+};
+
+// Runs every registered case and reports the failed checks.
+inline int RunAll() {
+    for (const Case& c : Cases()) {
+        int before = Failures();
+        c.body();
+        printf("%-48s %s\n", c.name, Failures() == before ? "ok" : "FAILED");
+    }
+    return Failures() == 0 ? 0 : 1;
+}
+
+};  // namespace Test
+
+#define TEST_CAT2(a, b) a##b
+#define TEST_CAT(a, b) TEST_CAT2(a, b)
+
+#define TEST(name)                                                                   \
+    static void TEST_CAT(test_, name)();                                             \
+    static Test::Register TEST_CAT(register_, name)(#name, TEST_CAT(test_, name)); \
+    static void TEST_CAT(test_, name)()
+
+#define CHECK(cond)                                                           \
+    do {                                                                      \
+        if (!(cond)) {                                                        \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            Test::Failures()++;                                               \
+        }                                                                     \
+    } while (0)
+
+#define TEST_MAIN() \
+    int main() { return Test::RunAll(); }
+
+#endif  // __UTILCPP_TEST_H__
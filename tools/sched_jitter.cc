@@ -0,0 +1,224 @@
+/**
+ * cpputil
+ *
+ * sched_jitter: qualifies a host for control loops, in the spirit of
+ * cyclictest but running this library's own schedulers. Every
+ * iteration's wakeup latency (actual wakeup minus intended deadline)
+ * goes into a histogram; at the end the tool reports latency
+ * percentiles, early wakeups, overruns and drift per scheduler.
+ *
+ *     sched_jitter --rate=1000 --duration=60 --cpu=2 --priority=80 --mlock
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "histogram.h"
+#include "realtime.h"
+#include "utils.h"
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct Options {
+    int rate = 1000;
+    double duration = 5.0;  // seconds per scheduler
+    int threads = 1;
+    int cpu = -1;           // first CPU; thread i is pinned to cpu + i
+    int priority = 0;
+    bool mlock = false;
+    int spin_us = 50;
+    std::string modes = "schedulerate,rateloop,rateloop-spin";
+    std::string json_path;
+};
+
+struct Report {
+    std::string mode;
+    Utils::Histogram late{7, uint64_t(10) * 1000000000};  // ns after the deadline
+    uint64_t iterations = 0;
+    uint64_t early = 0;        // woke before the deadline
+    uint64_t max_early = 0;    // ns
+    uint64_t overruns = 0;     // a whole period or more late
+    double drift_ms = 0;       // actual minus expected elapsed time
+    std::vector<std::string> notes;
+};
+
+void Usage(const char* argv0) {
+    Utils::PrintLnFmt(
+        "usage: %s [--rate=Hz] [--duration=s] [--threads=n] [--cpu=n] [--priority=1-99]\n"
+        "          [--mlock] [--spin-us=us] [--modes=schedulerate,rateloop,rateloop-spin]\n"
+        "          [--json=file]",
+        argv0);
+}
+
+bool Parse(int argc, char** argv, Options* o) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        auto value = [&](const char* key) -> const char* {
+            size_t n = strlen(key);
+            return strncmp(a, key, n) == 0 ? a + n : nullptr;
+        };
+        if (const char* v = value("--rate=")) o->rate = atoi(v);
+        else if (const char* v = value("--duration=")) o->duration = atof(v);
+        else if (const char* v = value("--threads=")) o->threads = std::max(1, atoi(v));
+        else if (const char* v = value("--cpu=")) o->cpu = atoi(v);
+        else if (const char* v = value("--priority=")) o->priority = atoi(v);
+        else if (const char* v = value("--spin-us=")) o->spin_us = atoi(v);
+        else if (const char* v = value("--modes=")) o->modes = v;
+        else if (const char* v = value("--json=")) o->json_path = v;
+        else if (strcmp(a, "--mlock") == 0) o->mlock = true;
+        else return false;
+    }
+    return o->rate > 0 && o->duration > 0;
+}
+
+void RecordWakeup(Report* r, Clock::time_point deadline, Clock::time_point woke,
+                  int64_t period_ns) {
+    int64_t late = std::chrono::duration_cast<std::chrono::nanoseconds>(woke - deadline).count();
+    if (late < 0) {
+        r->early++;
+        r->max_early = std::max<uint64_t>(r->max_early, -late);
+        late = 0;
+    }
+    if (late >= period_ns) r->overruns++;
+    r->late.Record((uint64_t)late);
+    r->iterations++;
+}
+
+// ScheduleRate is called as loops use it: once per iteration with the
+// time the iteration started. It aims 2 ms early on purpose, so early
+// wakeups are expected here, and at rates above 500 Hz the sleep
+// vanishes altogether and the loop spins; the report shows exactly that.
+void RunScheduleRate(const Options& o, Report* r) {
+    const int64_t period = 1000000000LL / o.rate;
+    const auto period_d = std::chrono::nanoseconds(period);
+    auto begin = Utils::Now();
+    auto end = begin + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>(o.duration));
+    auto start = begin;
+    while (start < end) {
+        Utils::ScheduleRate(o.rate, start);
+        auto woke = Utils::Now();
+        RecordWakeup(r, start + period_d, woke, period);
+        start = woke;
+    }
+    double expected = r->iterations * (double)period;
+    r->drift_ms = (std::chrono::duration<double, std::nano>(Utils::Now() - begin).count() - expected) / 1e6;
+}
+
+void RunRateLoop(const Options& o, bool spin, Report* r) {
+    Utils::RateLoop loop(o.rate);
+    if (spin) loop.SetSpin(std::chrono::microseconds(o.spin_us));
+    const int64_t period = loop.Period().count();
+    auto begin = Utils::Now();
+    auto end = begin + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>(o.duration));
+    while (Utils::Now() < end) {
+        loop.Wait();
+        RecordWakeup(r, loop.Deadline(), Utils::Now(), period);
+    }
+    r->overruns = loop.Overruns();
+    double expected = r->iterations * (double)period;
+    r->drift_ms = (std::chrono::duration<double, std::nano>(Utils::Now() - begin).count() - expected) / 1e6;
+}
+
+Report RunMode(const Options& o, const std::string& mode) {
+    Report total;
+    total.mode = mode;
+    std::mutex mutex;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < o.threads; t++) {
+        threads.emplace_back([&, t] {
+            Utils::ThreadConfig cfg;
+            cfg.cpu = o.cpu >= 0 ? o.cpu + t : -1;
+            cfg.priority = o.priority;
+            cfg.lock_memory = o.mlock;
+            cfg.prefault_stack = 64 * 1024;
+            Utils::ThreadConfigResult applied = Utils::ConfigureCurrentThread(cfg);
+
+            Report r;
+            if (mode == "schedulerate")
+                RunScheduleRate(o, &r);
+            else
+                RunRateLoop(o, mode == "rateloop-spin", &r);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            total.late.Merge(r.late);
+            total.iterations += r.iterations;
+            total.early += r.early;
+            total.max_early = std::max(total.max_early, r.max_early);
+            total.overruns += r.overruns;
+            if (std::abs(r.drift_ms) > std::abs(total.drift_ms)) total.drift_ms = r.drift_ms;
+            total.notes.push_back(Utils::StrFmt("thread %d: %s", t, applied.Summary()));
+        });
+    }
+    for (auto& th : threads) th.join();
+    return total;
+}
+
+void Print(const Report& r) {
+    const auto& h = r.late;
+    Utils::PrintLnFmt("%-14s iters %-8llu late us: p50 %8.1f p99 %8.1f p99.9 %8.1f max %8.1f | "
+                      "early %llu (max %.1f us) | overruns %llu | drift %.3f ms",
+                      r.mode, (unsigned long long)r.iterations, h.Percentile(50) / 1e3,
+                      h.Percentile(99) / 1e3, h.Percentile(99.9) / 1e3, h.Max() / 1e3,
+                      (unsigned long long)r.early, r.max_early / 1e3,
+                      (unsigned long long)r.overruns, r.drift_ms);
+    for (const auto& n : r.notes) Utils::PrintLnFmt("    %s", n);
+}
+
+void WriteJson(const std::string& path, const Options& o, const std::vector<Report>& reports) {
+    std::ofstream out(path);
+    out << Utils::StrFmt("{\"rate\":%d,\"duration\":%.3f,\"threads\":%d,\"results\":[", o.rate,
+                         o.duration, o.threads);
+    for (size_t i = 0; i < reports.size(); i++) {
+        const Report& r = reports[i];
+        out << (i ? ",\n" : "\n")
+            << Utils::StrFmt(
+                   "{\"mode\":\"%s\",\"iterations\":%llu,\"late_ns\":{\"p50\":%llu,\"p99\":%llu,"
+                   "\"p999\":%llu,\"max\":%llu,\"mean\":%.1f},\"early\":%llu,\"max_early_ns\":%llu,"
+                   "\"overruns\":%llu,\"drift_ms\":%.6f}",
+                   r.mode, (unsigned long long)r.iterations,
+                   (unsigned long long)r.late.Percentile(50), (unsigned long long)r.late.Percentile(99),
+                   (unsigned long long)r.late.Percentile(99.9), (unsigned long long)r.late.Max(),
+                   r.late.Mean(), (unsigned long long)r.early, (unsigned long long)r.max_early,
+                   (unsigned long long)r.overruns, r.drift_ms);
+    }
+    out << "\n]}\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options o;
+    if (!Parse(argc, argv, &o)) {
+        Usage(argv[0]);
+        return 2;
+    }
+    Utils::LogFmt("sched_jitter: %d Hz, %.1f s per scheduler, %d thread(s)", o.rate, o.duration,
+                  o.threads);
+
+    std::vector<Report> reports;
+    std::stringstream modes(o.modes);
+    std::string mode;
+    while (std::getline(modes, mode, ',')) {
+        if (mode != "schedulerate" && mode != "rateloop" && mode != "rateloop-spin") {
+            Utils::PrintLnFmt("unknown mode %s", mode);
+            return 2;
+        }
+        reports.push_back(RunMode(o, mode));
+        Print(reports.back());
+    }
+    if (!o.json_path.empty()) WriteJson(o.json_path, o, reports);
+    return 0;
+}
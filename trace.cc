@@ -0,0 +1,232 @@
+/**
+ * cpputil
+ *
+ * Chrome trace event recorder.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "trace.h"
+
+#include <unistd.h>
+
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils.h"
+
+std::atomic<bool> Utils::_trace_enabled{false};
+
+namespace {
+
+constexpr size_t kRingEvents = 8192;  // per thread, power of two
+
+struct TraceEvent {
+    int64_t ts;  // ns, clock source time
+    const char* name;
+    double value;
+    char phase;  // B, E, i or C
+};
+
+// Single producer (the owning thread), single consumer (the flusher).
+struct ThreadRing {
+    TraceEvent events[kRingEvents];
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<const char*> thread_name{nullptr};
+    const char* written_name = nullptr;
+    std::atomic<bool> exited{false};
+    int tid = 0;
+
+    void Push(char phase, const char* name, double value) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == kRingEvents) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        events[h & (kRingEvents - 1)] =
+            TraceEvent{Utils::Now().time_since_epoch().count(), name, value, phase};
+        head.store(h + 1, std::memory_order_release);
+    }
+};
+
+struct Recorder {
+    std::mutex mutex;  // guards rings, file and the flusher state
+    std::condition_variable cv;
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+    std::ofstream out;
+    bool first_event = true;
+    bool running = false;
+    std::thread flusher;
+    std::chrono::milliseconds interval{500};
+    int next_tid = 1;
+    uint64_t dropped = 0;
+};
+
+Recorder& GetRecorder() {
+    static Recorder* recorder = new Recorder();  // outlives exiting threads
+    return *recorder;
+}
+
+// Keeps the calling thread's ring registered; marks it for removal once
+// the thread exits and its events have been written.
+struct RingHolder {
+    std::shared_ptr<ThreadRing> ring;
+    ~RingHolder() {
+        if (ring) ring->exited.store(true, std::memory_order_release);
+    }
+};
+
+thread_local RingHolder ring_holder;
+
+ThreadRing& LocalRing() {
+    if (!ring_holder.ring) {
+        auto ring = std::make_shared<ThreadRing>();
+        Recorder& r = GetRecorder();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        ring->tid = r.next_tid++;
+        r.rings.push_back(ring);
+        ring_holder.ring = std::move(ring);
+    }
+    return *ring_holder.ring;
+}
+
+std::string JsonEscape(const char* s) {
+    std::string out;
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') out += '\\';
+        if ((unsigned char)*s < 0x20) continue;
+        out += *s;
+    }
+    return out;
+}
+
+void WriteEvent(Recorder& r, const std::string& json) {
+    r.out << (r.first_event ? "\n" : ",\n") << json;
+    r.first_event = false;
+}
+
+// Writes out everything buffered so far. Callers hold r.mutex.
+void Drain(Recorder& r) {
+    const int pid = (int)getpid();
+    for (auto it = r.rings.begin(); it != r.rings.end();) {
+        ThreadRing& ring = **it;
+        const char* name = ring.thread_name.load(std::memory_order_acquire);
+        if (name != nullptr && name != ring.written_name) {
+            WriteEvent(r, Utils::StrFmt("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                                        "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                                        pid, ring.tid, JsonEscape(name)));
+            ring.written_name = name;
+        }
+
+        bool exited = ring.exited.load(std::memory_order_acquire);
+        uint64_t t = ring.tail.load(std::memory_order_relaxed);
+        uint64_t h = ring.head.load(std::memory_order_acquire);
+        for (; t != h; t++) {
+            const TraceEvent& e = ring.events[t & (kRingEvents - 1)];
+            std::string common = Utils::StrFmt(
+                "\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+                JsonEscape(e.name), e.phase, e.ts / 1000.0,
+                pid, ring.tid);
+            if (e.phase == 'C')
+                WriteEvent(r, Utils::StrFmt("{%s,\"args\":{\"value\":%.17g}}", common, e.value));
+            else if (e.phase == 'i')
+                WriteEvent(r, "{" + common + ",\"s\":\"t\"}");
+            else
+                WriteEvent(r, "{" + common + "}");
+        }
+        ring.tail.store(t, std::memory_order_release);
+        r.dropped += ring.dropped.exchange(0, std::memory_order_relaxed);
+
+        if (exited)
+            it = r.rings.erase(it);
+        else
+            ++it;
+    }
+    r.out.flush();
+}
+
+void FlushLoop() {
+    Recorder& r = GetRecorder();
+    std::unique_lock<std::mutex> lock(r.mutex);
+    while (r.running) {
+        r.cv.wait_for(lock, r.interval);
+        Drain(r);
+    }
+}
+
+}  // namespace
+
+/**
+ * @brief Starts recording a trace.
+ *
+ * @param path The JSON file to write.
+ * @param flush_interval How often the background thread writes buffered
+ * events. Per-thread buffers hold 8192 events, so this should be short
+ * enough that no thread records more than that in one interval.
+ *
+ * @return False if a trace is already running or the file cannot be opened.
+ */
+bool Utils::StartTrace(const std::string& path, std::chrono::milliseconds flush_interval) {
+    Recorder& r = GetRecorder();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.running) return false;
+    r.out.open(path, std::ios::out | std::ios::trunc);
+    if (!r.out) return false;
+    r.out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    r.first_event = true;
+    r.dropped = 0;
+    r.interval = flush_interval;
+    // Throw away anything left over from an earlier trace.
+    for (auto& ring : r.rings) {
+        ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+        ring->written_name = nullptr;
+    }
+    r.running = true;
+    _trace_enabled.store(true, std::memory_order_release);
+    r.flusher = std::thread(FlushLoop);
+    return true;
+}
+
+uint64_t Utils::StopTrace() {
+    Recorder& r = GetRecorder();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (!r.running) return 0;
+        _trace_enabled.store(false, std::memory_order_release);
+        r.running = false;
+    }
+    r.cv.notify_all();
+    r.flusher.join();
+
+    std::lock_guard<std::mutex> lock(r.mutex);
+    Drain(r);
+    r.out << "\n]}\n";
+    r.out.close();
+    return r.dropped;
+}
+
+void Utils::TraceBegin(const char* name) {
+    if (TraceEnabled()) LocalRing().Push('B', name, 0);
+}
+
+void Utils::TraceEnd(const char* name) {
+    if (TraceEnabled()) LocalRing().Push('E', name, 0);
+}
+
+void Utils::TraceInstant(const char* name) {
+    if (TraceEnabled()) LocalRing().Push('i', name, 0);
+}
+
+void Utils::TraceCounter(const char* name, double value) {
+    if (TraceEnabled()) LocalRing().Push('C', name, value);
+}
+
+void Utils::TraceThreadName(const char* name) {
+    LocalRing().thread_name.store(name, std::memory_order_release);
+}
@@ -0,0 +1,73 @@
+/**
+ * cpputil
+ *
+ * Trace recorder writing the Chrome trace event format, which
+ * chrome://tracing and ui.perfetto.dev both load. Events go into
+ * per-thread lock-free ring buffers and a background thread
+ * writes them out, so recording never touches the file.
+ *
+ *     Utils::StartTrace("run.json");
+ *     ...                            // UTILS_ZONE scopes show up as slices
+ *     Utils::StopTrace();
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_TRACE_H__
+#define __UTILCPP_TRACE_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace Utils {
+
+extern std::atomic<bool> _trace_enabled;
+
+// True while a trace is being recorded. One relaxed load.
+inline bool TraceEnabled() { return _trace_enabled.load(std::memory_order_relaxed); }
+
+// Starts recording to the given file. Buffered events are written every
+// flush_interval by a background thread, and the rest at StopTrace.
+// Returns false if the file cannot be opened or a trace is already
+// running.
+bool StartTrace(const std::string& path,
+                std::chrono::milliseconds flush_interval = std::chrono::milliseconds(500));
+
+// Stops recording, writes every remaining event and closes the file.
+// Returns the number of events dropped because a buffer was full.
+uint64_t StopTrace();
+
+// Event recording. Names are stored by pointer, so they must be string
+// literals or otherwise outlive the trace. Timestamps come from the
+// installed clock source, the same clock as PreciseTime. These do
+// nothing unless a trace is running.
+void TraceBegin(const char* name);
+void TraceEnd(const char* name);
+void TraceInstant(const char* name);
+void TraceCounter(const char* name, double value);
+
+// Names the calling thread in the trace viewer. Same lifetime rule.
+void TraceThreadName(const char* name);
+
+// Records a begin/end pair around the enclosing scope.
+class TraceScope {
+   public:
+    explicit TraceScope(const char* name) : name_(TraceEnabled() ? name : nullptr) {
+        if (name_) TraceBegin(name_);
+    }
+    ~TraceScope() {
+        if (name_) TraceEnd(name_);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+   private:
+    const char* name_;
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_TRACE_H__
@@ -103,9 +103,77 @@ void Utils::BufAppendFloat32(uint8_t* buffer, float number, float scale, int32_t
     BufAppendInt32(buffer, (int32_t)(number * scale), index);
 }
 
+/**
+ * @brief Reads a 16-bit integer written by BufAppendInt16.
+ *
+ * @param buffer The buffer to read from.
+ * @param index A pointer to the index of the first byte. The index is
+ * incremented by 2.
+ *
+ * @return The integer.
+ */
+int16_t Utils::BufReadInt16(const uint8_t* buffer, int32_t* index) {
+    uint16_t v = (uint16_t)buffer[*index] << 8 | buffer[*index + 1];
+    *index += 2;
+    return (int16_t)v;
+}
+
+/**
+ * @brief Reads a 32-bit integer written by BufAppendInt32.
+ *
+ * @param buffer The buffer to read from.
+ * @param index A pointer to the index of the first byte. The index is
+ * incremented by 4.
+ *
+ * @return The integer.
+ */
+int32_t Utils::BufReadInt32(const uint8_t* buffer, int32_t* index) {
+    uint32_t v = (uint32_t)buffer[*index] << 24 | (uint32_t)buffer[*index + 1] << 16 |
+                 (uint32_t)buffer[*index + 2] << 8 | buffer[*index + 3];
+    *index += 4;
+    return (int32_t)v;
+}
+
+/**
+ * @brief Reads a number written by BufAppendFloat16.
+ *
+ * BufAppendFloat16 truncates number * scale to an integer, so the result
+ * is within 1 / scale of the number that was appended, as long as that
+ * product fit in 16 bits.
+ *
+ * @param buffer The buffer to read from.
+ * @param scale The scale the number was appended with.
+ * @param index A pointer to the index of the first byte. The index is
+ * incremented by 2.
+ *
+ * @return The number.
+ */
+float Utils::BufReadFloat16(const uint8_t* buffer, float scale, int32_t* index) {
+    return BufReadInt16(buffer, index) / scale;
+}
+
+/**
+ * @brief Reads a number written by BufAppendFloat32.
+ *
+ * @param buffer The buffer to read from.
+ * @param scale The scale the number was appended with.
+ * @param index A pointer to the index of the first byte. The index is
+ * incremented by 4.
+ *
+ * @return The number, within 1 / scale of the one appended (and subject
+ * to float precision for large values).
+ */
+float Utils::BufReadFloat32(const uint8_t* buffer, float scale, int32_t* index) {
+    return BufReadInt32(buffer, index) / scale;
+}
+
 
 std::string Utils::CurrentDateTimeStr(const char* fmt) {
     time_t now = time(0);
+    if (_clock_source.load(std::memory_order_acquire) != nullptr)
+        now = (time_t)std::chrono::duration_cast<std::chrono::seconds>(
+                  Now().time_since_epoch())
+                  .count();
     struct tm tstruct;
     char buf[80];
     tstruct = *localtime(&now);
@@ -113,13 +181,94 @@ std::string Utils::CurrentDateTimeStr(const char* fmt) {
     return buf;
 }
 
+std::atomic<Utils::ClockSource*> Utils::_clock_source{nullptr};
+
+Utils::ClockSource::time_point Utils::SystemClock::Now() {
+    return std::chrono::high_resolution_clock::now();
+}
+
+void Utils::SystemClock::SleepUntil(time_point t) {
+    std::this_thread::sleep_until(t);
+}
+
+// The OS usually wakes us up a little late. ScheduleRate has always
+// aimed 2 ms early to make up for it.
+std::chrono::nanoseconds Utils::SystemClock::WakeupLatency() const {
+    return std::chrono::milliseconds(2);
+}
+
+Utils::VirtualClock::VirtualClock(time_point start)
+    : now_ns_(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  start.time_since_epoch())
+                  .count()) {}
+
+Utils::ClockSource::time_point Utils::VirtualClock::Now() {
+    return time_point(std::chrono::duration_cast<time_point::duration>(
+        std::chrono::nanoseconds(now_ns_.load(std::memory_order_acquire))));
+}
+
+/**
+ * @brief Advances virtual time to the given deadline, without sleeping.
+ *
+ * Time never moves backwards: sleeping until a point in the past returns
+ * immediately and leaves the clock as it is.
+ *
+ * @param t The deadline to advance to.
+ */
+void Utils::VirtualClock::SleepUntil(time_point t) {
+    int64_t target =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch())
+            .count();
+    int64_t cur = now_ns_.load(std::memory_order_relaxed);
+    while (cur < target &&
+           !now_ns_.compare_exchange_weak(cur, target, std::memory_order_acq_rel)) {
+    }
+}
+
+void Utils::VirtualClock::Advance(std::chrono::nanoseconds d) {
+    now_ns_.fetch_add(d.count(), std::memory_order_acq_rel);
+}
+
+void Utils::VirtualClock::Set(time_point t) {
+    now_ns_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      t.time_since_epoch())
+                      .count(),
+                  std::memory_order_release);
+}
+
+void Utils::SetClockSource(ClockSource* source) {
+    _clock_source.store(source, std::memory_order_release);
+}
+
+Utils::ClockSource& Utils::GetClockSource() {
+    static SystemClock system_clock;
+    ClockSource* c = _clock_source.load(std::memory_order_acquire);
+    return c ? *c : system_clock;
+}
+
+Utils::ScopedClockSource::ScopedClockSource(ClockSource* source)
+    : previous_(_clock_source.exchange(source, std::memory_order_acq_rel)) {}
+
+Utils::ScopedClockSource::~ScopedClockSource() { SetClockSource(previous_); }
+
+void Utils::SleepUntil(std::chrono::high_resolution_clock::time_point t) {
+    GetClockSource().SleepUntil(t);
+}
+
+void Utils::SleepFor(std::chrono::nanoseconds d) {
+    ClockSource& c = GetClockSource();
+    c.SleepUntil(c.Now() + std::chrono::duration_cast<
+                               std::chrono::high_resolution_clock::duration>(d));
+}
+
 /**
  * @brief Enforces a rate (Hz) on a loop and returns the time elapsed since the
  * last call.
  *
  * This function calculates the time elapsed since the last call and sleeps if
  * necessary to enforce the specified rate. If the elapsed time is greater than
- * the specified rate, it returns the elapsed time in seconds.
+ * the specified rate, it returns the elapsed time in seconds. Time is read
+ * from, and sleeps go through, the installed clock source.
  *
  * @param rate The desired rate in Hz.
  * @param start_time The time point from which to calculate the elapsed time.
@@ -128,17 +277,20 @@ std::string Utils::CurrentDateTimeStr(const char* fmt) {
  */
 double Utils::ScheduleRate(
     int rate, std::chrono::high_resolution_clock::time_point start_time) {
+    using std::chrono::high_resolution_clock;
+    ClockSource& clock = GetClockSource();
     int dt = std::chrono::duration_cast<std::chrono::milliseconds>(
-                 std::chrono::high_resolution_clock::now() - start_time)
+                 clock.Now() - start_time)
                  .count();
     if (dt < 1000 / rate) {
-        std::this_thread::sleep_for(
-            std::chrono::milliseconds(int(1000.0 / rate - dt - 2)));
+        auto period = std::chrono::duration_cast<high_resolution_clock::duration>(
+            std::chrono::duration<double>(1.0 / rate));
+        clock.SleepUntil(start_time + period - clock.WakeupLatency());
     } else {
         return dt / 1000.0;
     }
     return std::chrono::duration_cast<std::chrono::milliseconds>(
-               std::chrono::high_resolution_clock::now() - start_time)
+               clock.Now() - start_time)
                .count() / 1000.0;
 }
 
@@ -16,19 +16,28 @@
 #define __UTILCPP_H__
 
 #include <stdint.h>
+#include <atomic>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
 #define _USE_MATH_DEFINES
 #include <sys/time.h>
 #include <cmath>
 
+#include "vecsearch.h"
+
 #ifdef __GNUC__
 #define vsprintf_s vsnprintf
 #define sprintf_s snprintf
@@ -44,16 +53,67 @@ void BufAppendInt32(uint8_t* buffer, int32_t number, int32_t* index);
 void BufAppendFloat16(uint8_t* buffer, float number, float scale, int32_t* index);
 void BufAppendFloat32(uint8_t* buffer, float number, float scale, int32_t* index);
 
+// The inverses of the BufAppend functions: read a big-endian value at
+// *index and advance it.
+int16_t BufReadInt16(const uint8_t* buffer, int32_t* index);
+int32_t BufReadInt32(const uint8_t* buffer, int32_t* index);
+float BufReadFloat16(const uint8_t* buffer, float scale, int32_t* index);
+float BufReadFloat32(const uint8_t* buffer, float scale, int32_t* index);
+
 // Returns a YYYY-MM-DD HH:MM:SS format date for the current day.
 std::string CurrentDateTimeStr(const char* fmt = "%Y-%m-%d %H:%M:%S");
 
+// True if map.find(key) compiles as is: the key type itself, anything
+// that converts to it, or any type the map's transparent comparator or
+// hasher accepts.
+template <typename Map, typename Key, typename = void>
+struct _map_finds : std::false_type {};
+template <typename Map, typename Key>
+struct _map_finds<Map, Key,
+                  std::void_t<decltype(std::declval<Map&>().find(std::declval<const Key&>()))>>
+    : std::true_type {};
+
+// Looks up a key in any map with find() and end() (std::map,
+// std::unordered_map, FlatMap, ...) and returns a pointer to the value,
+// or nullptr. Keys the map cannot search by directly, like a string_view
+// in a std::map<std::string, V>, are converted to its key type first.
+template <typename Map, typename Key>
+auto MapFind(Map& map, const Key& key) -> decltype(&map.begin()->second) {
+    auto it = [&] {
+        if constexpr (_map_finds<Map, Key>::value)
+            return map.find(key);
+        else
+            return map.find(typename std::remove_const_t<Map>::key_type(key));
+    }();
+    return it == map.end() ? nullptr : &it->second;
+}
+
 // A function to extend the functionality of the Java
-// Map interface's getOrDefault method to the C++ map.
-// template<typename K, typename V>
-template <typename K, typename V>
-V MapGetOrDefault(const std::map<K, V> map, const K key, const V default_val) {
-    auto it = map.find(key);
-    return it == map.end() ? default_val : it->second;
+// Map interface's getOrDefault method to any C++ map. Nothing but the
+// value returned is copied.
+template <typename Map, typename Key>
+typename Map::mapped_type MapGetOrDefault(const Map& map, const Key& key,
+                                          const typename Map::mapped_type& default_val) {
+    auto value = MapFind(map, key);
+    return value ? *value : default_val;
+}
+
+// The same, but returns a reference to the value or to default_val, for
+// values that are expensive to copy. Don't hold on to the result when
+// default_val is a temporary.
+template <typename Map, typename Key>
+const typename Map::mapped_type& MapGetOrDefaultRef(
+    const Map& map, const Key& key, const typename Map::mapped_type& default_val) {
+    auto value = MapFind(map, key);
+    return value ? *value : default_val;
+}
+
+// The value for key, or an empty optional.
+template <typename Map, typename Key>
+std::optional<typename Map::mapped_type> MapGet(const Map& map, const Key& key) {
+    auto value = MapFind(map, key);
+    if (!value) return std::nullopt;
+    return *value;
 }
 
 // A function to clamp a given value between an upper and lower bound
@@ -131,19 +191,116 @@ void ErrFmt(const std::string& fmt, A&&... args) {
 
 // Returns true if element x is present inside of the vector v.
 template <typename T>
-inline bool VecContains(const std::vector<T> v, const T x) {
-    return std::find(v.begin(), v.end(), x) != v.end();
+inline bool VecContains(const std::vector<T>& v, const T& x) {
+    return FindFirst(v.data(), v.size(), x) != v.size();
+}
+
+// Returns true if element x is present in data[0, size).
+template <typename T>
+inline bool VecContains(const T* data, size_t size, const T& x) {
+    return FindFirst(data, size, x) != size;
 }
 
 // Returns the index of element x if it is present inside of the
 // vector v, otherwise returns -1.
 template <typename T>
-inline long VecIndexOf(const std::vector<T> v, const T x) {
-    ptrdiff_t pos = find(v.begin(), v.end(), x) - v.begin();
-    if (pos >= v.size()) return -1;
-    return pos;
+inline long VecIndexOf(const std::vector<T>& v, const T& x) {
+    size_t pos = FindFirst(v.data(), v.size(), x);
+    return pos == v.size() ? -1 : (long)pos;
+}
+
+// Returns the index of element x in data[0, size), otherwise -1.
+template <typename T>
+inline long VecIndexOf(const T* data, size_t size, const T& x) {
+    size_t pos = FindFirst(data, size, x);
+    return pos == size ? -1 : (long)pos;
+}
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+template <typename T, size_t N>
+inline bool VecContains(std::span<T, N> s, const std::remove_cv_t<T>& x) {
+    return VecContains<std::remove_cv_t<T>>(s.data(), s.size(), x);
 }
 
+template <typename T, size_t N>
+inline long VecIndexOf(std::span<T, N> s, const std::remove_cv_t<T>& x) {
+    return VecIndexOf<std::remove_cv_t<T>>(s.data(), s.size(), x);
+}
+#endif
+
+// A source of time for ScheduleRate, PreciseTime and CurrentDateTimeStr.
+// By default the real clock is used. Installing a VirtualClock lets
+// rate-controlled code run as fast as the CPU allows, with every sleep
+// completing instantly and deterministically.
+class ClockSource {
+   public:
+    using time_point = std::chrono::high_resolution_clock::time_point;
+
+    virtual ~ClockSource() = default;
+    virtual time_point Now() = 0;
+    virtual void SleepUntil(time_point t) = 0;
+
+    // How much earlier than its deadline a sleeper should ask to be woken
+    // to absorb the scheduler's wakeup latency.
+    virtual std::chrono::nanoseconds WakeupLatency() const { return {}; }
+};
+
+// The real clock: high_resolution_clock and std::this_thread sleeps.
+class SystemClock : public ClockSource {
+   public:
+    time_point Now() override;
+    void SleepUntil(time_point t) override;
+    std::chrono::nanoseconds WakeupLatency() const override;
+};
+
+// A simulated clock. Time only moves when someone sleeps or calls
+// Advance/Set, and a sleep jumps straight to its deadline. Sleeps from
+// several threads each move the clock forward to their own deadline, so
+// timelines are only reproducible when one thread drives the clock.
+class VirtualClock : public ClockSource {
+   public:
+    explicit VirtualClock(time_point start = time_point{});
+
+    time_point Now() override;
+    void SleepUntil(time_point t) override;
+
+    void Advance(std::chrono::nanoseconds d);
+    void Set(time_point t);
+
+   private:
+    std::atomic<int64_t> now_ns_;
+};
+
+// Installs a clock source for the whole process. Passing nullptr goes
+// back to the real clock. The caller keeps ownership of the source.
+void SetClockSource(ClockSource* source);
+ClockSource& GetClockSource();
+
+// Installs a clock source for the lifetime of the object.
+class ScopedClockSource {
+   public:
+    explicit ScopedClockSource(ClockSource* source);
+    ~ScopedClockSource();
+    ScopedClockSource(const ScopedClockSource&) = delete;
+    ScopedClockSource& operator=(const ScopedClockSource&) = delete;
+
+   private:
+    ClockSource* previous_;
+};
+
+extern std::atomic<ClockSource*> _clock_source;
+
+// The current time according to the installed clock source. Without a
+// source this is a plain high_resolution_clock::now().
+inline std::chrono::high_resolution_clock::time_point Now() {
+    ClockSource* c = _clock_source.load(std::memory_order_acquire);
+    return c ? c->Now() : std::chrono::high_resolution_clock::now();
+}
+
+// Sleeps on the installed clock source.
+void SleepUntil(std::chrono::high_resolution_clock::time_point t);
+void SleepFor(std::chrono::nanoseconds d);
+
 double ScheduleRate(int rate, std::chrono::high_resolution_clock::time_point start_time);
 
 double NormalizeAnglePositive(double angle);
@@ -156,7 +313,7 @@ using t_ms = std::chrono::milliseconds;
 template<typename A, typename T>
 inline A PreciseTime() 
 {
-    auto now = std::chrono::high_resolution_clock::now().time_since_epoch();
+    auto now = Now().time_since_epoch();
     return static_cast<A>(std::chrono::duration_cast<T>(now).count());
 }
 
@@ -0,0 +1,234 @@
+/**
+ * cpputil
+ *
+ * Vectorized linear search. FindFirst compares a whole register of
+ * elements per instruction and turns the result into a bit mask, so
+ * scanning an ID list runs at memory speed instead of one element per
+ * cycle. Integer and floating point element types use AVX2 when the
+ * build enables it (-mavx2 or -march=native), SSE2 otherwise on x86-64,
+ * and std::find everywhere else. Results are exactly those of
+ * std::find: NaN is never found, and -0.0 finds 0.0.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_VECSEARCH_H__
+#define __UTILCPP_VECSEARCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define UTILS_SIMD_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define UTILS_SIMD_SSE2 1
+#endif
+
+namespace Utils {
+
+#if defined(UTILS_SIMD_AVX2) || defined(UTILS_SIMD_SSE2)
+
+// One register's worth of loads, compares and masks. Masks have one bit
+// per byte, so a match in element i of width w sets bits i*w..i*w+w-1.
+struct _simd {
+#ifdef UTILS_SIMD_AVX2
+    using reg = __m256i;
+    static constexpr size_t kBytes = 32;
+    static reg Load(const void* p) { return _mm256_loadu_si256((const __m256i*)p); }
+    static reg Or(reg a, reg b) { return _mm256_or_si256(a, b); }
+    static uint32_t Mask(reg a) { return (uint32_t)_mm256_movemask_epi8(a); }
+    static reg Zero() { return _mm256_setzero_si256(); }
+    static reg SubBytes(reg a, reg b) { return _mm256_sub_epi8(a, b); }
+    // Each 64-bit lane of the sum is at most 8 * 255, so the low 32 bits
+    // hold it; the 64-bit extracts are not available on 32-bit x86.
+    static uint64_t SumBytes(reg a) {
+        __m256i s = _mm256_sad_epu8(a, _mm256_setzero_si256());
+        __m128i h = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+        return (uint32_t)_mm_cvtsi128_si32(h) +
+               (uint32_t)_mm_cvtsi128_si32(_mm_unpackhi_epi64(h, h));
+    }
+#else
+    using reg = __m128i;
+    static constexpr size_t kBytes = 16;
+    static reg Load(const void* p) { return _mm_loadu_si128((const __m128i*)p); }
+    static reg Or(reg a, reg b) { return _mm_or_si128(a, b); }
+    static uint32_t Mask(reg a) { return (uint32_t)_mm_movemask_epi8(a); }
+    static reg Zero() { return _mm_setzero_si128(); }
+    static reg SubBytes(reg a, reg b) { return _mm_sub_epi8(a, b); }
+    // As above, 32-bit reads of the two lane sums.
+    static uint64_t SumBytes(reg a) {
+        __m128i s = _mm_sad_epu8(a, _mm_setzero_si128());
+        return (uint32_t)_mm_cvtsi128_si32(s) +
+               (uint32_t)_mm_cvtsi128_si32(_mm_unpackhi_epi64(s, s));
+    }
+#endif
+};
+
+// Splat and lane-wise equality for each supported element type.
+template <typename T, typename = void>
+struct _simd_eq;
+
+template <typename T>
+struct _simd_eq<T, std::enable_if_t<std::is_integral<T>::value && sizeof(T) == 1>> {
+#ifdef UTILS_SIMD_AVX2
+    static _simd::reg Splat(T x) { return _mm256_set1_epi8((char)x); }
+    static _simd::reg Eq(_simd::reg a, _simd::reg b) { return _mm256_cmpeq_epi8(a, b); }
+#else
+    static _simd::reg Splat(T x) { return _mm_set1_epi8((char)x); }
+    static _simd::reg Eq(_simd::reg a, _simd::reg b) { return _mm_cmpeq_epi8(a, b); }
+#endif
+};
+
+template <typename T>
+struct _simd_eq<T, std::enable_if_t<std::is_integral<T>::value && sizeof(T) == 2>> {
+#ifdef UTILS_SIMD_AVX2
+    static _simd::reg Splat(T x) { return _mm256_set1_epi16((short)x); }
+    static _simd::reg Eq(_simd::reg a, _simd::reg b) { return _mm256_cmpeq_epi16(a, b); }
+#else
+    static _simd::reg Splat(T x) { return _mm_set1_epi16((short)x); }
+    static _simd::reg Eq(_simd::reg a, _simd::reg b) { return _mm_cmpeq_epi16(a, b); }
+#endif
+};
+
+template <typename T>
+struct _simd_eq<T, std::enable_if_t<std::is_integral<T>::value && sizeof(T) == 4>> {
+#ifdef UTILS_SIMD_AVX2
+    static _simd::reg Splat(T x) { return _mm256_set1_epi32((int)x); }
+    static _simd::reg Eq(_simd::reg a, _simd::reg b) { return _mm256_cmpeq_epi32(a, b); }
+#else
+    static _simd::reg Splat(T x) { return _mm_set1_epi32((int)x); }
+    static _simd::reg Eq(_simd::reg a, _simd::reg b) { return _mm_cmpeq_epi32(a, b); }
+#endif
+};
+
+template <typename T>
+struct _simd_eq<T, std::enable_if_t<std::is_integral<T>::value && sizeof(T) == 8>> {
+#ifdef UTILS_SIMD_AVX2
+    static _simd::reg Splat(T x) { return _mm256_set1_epi64x((long long)x); }
+    static _simd::reg Eq(_simd::reg a, _simd::reg b) { return _mm256_cmpeq_epi64(a, b); }
+#else
+    static _simd::reg Splat(T x) { return _mm_set1_epi64x((long long)x); }
+    // SSE2 has no 64-bit compare: a lane is equal when both of its 32-bit
+    // halves are.
+    static _simd::reg Eq(_simd::reg a, _simd::reg b) {
+        __m128i eq = _mm_cmpeq_epi32(a, b);
+        return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+#endif
+};
+
+template <>
+struct _simd_eq<float> {
+#ifdef UTILS_SIMD_AVX2
+    static _simd::reg Splat(float x) { return _mm256_castps_si256(_mm256_set1_ps(x)); }
+    static _simd::reg Eq(_simd::reg a, _simd::reg b) {
+        return _mm256_castps_si256(
+            _mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _CMP_EQ_OQ));
+    }
+#else
+    static _simd::reg Splat(float x) { return _mm_castps_si128(_mm_set1_ps(x)); }
+    static _simd::reg Eq(_simd::reg a, _simd::reg b) {
+        return _mm_castps_si128(_mm_cmpeq_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+    }
+#endif
+};
+
+template <>
+struct _simd_eq<double> {
+#ifdef UTILS_SIMD_AVX2
+    static _simd::reg Splat(double x) { return _mm256_castpd_si256(_mm256_set1_pd(x)); }
+    static _simd::reg Eq(_simd::reg a, _simd::reg b) {
+        return _mm256_castpd_si256(
+            _mm256_cmp_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b), _CMP_EQ_OQ));
+    }
+#else
+    static _simd::reg Splat(double x) { return _mm_castpd_si128(_mm_set1_pd(x)); }
+    static _simd::reg Eq(_simd::reg a, _simd::reg b) {
+        return _mm_castpd_si128(_mm_cmpeq_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+    }
+#endif
+};
+
+template <typename T>
+constexpr bool _simd_searchable =
+    (std::is_integral<T>::value && !std::is_same<T, bool>::value) ||
+    std::is_same<T, float>::value || std::is_same<T, double>::value;
+
+// Four registers per iteration, so the loop is bound by loads rather
+// than by the branch on the combined mask.
+template <typename T>
+size_t _simd_find_first(const T* data, size_t size, T x) {
+    using Eq = _simd_eq<T>;
+    constexpr size_t kLanes = _simd::kBytes / sizeof(T);
+    const _simd::reg needle = Eq::Splat(x);
+    size_t i = 0;
+    for (; i + 4 * kLanes <= size; i += 4 * kLanes) {
+        _simd::reg e0 = Eq::Eq(_simd::Load(data + i), needle);
+        _simd::reg e1 = Eq::Eq(_simd::Load(data + i + kLanes), needle);
+        _simd::reg e2 = Eq::Eq(_simd::Load(data + i + 2 * kLanes), needle);
+        _simd::reg e3 = Eq::Eq(_simd::Load(data + i + 3 * kLanes), needle);
+        if (_simd::Mask(_simd::Or(_simd::Or(e0, e1), _simd::Or(e2, e3))) == 0) continue;
+        const _simd::reg e[4] = {e0, e1, e2, e3};
+        for (size_t k = 0; k < 4; k++)
+            if (uint32_t m = _simd::Mask(e[k]))
+                return i + k * kLanes + __builtin_ctz(m) / sizeof(T);
+    }
+    for (; i + kLanes <= size; i += kLanes)
+        if (uint32_t m = _simd::Mask(Eq::Eq(_simd::Load(data + i), needle)))
+            return i + __builtin_ctz(m) / sizeof(T);
+    for (; i < size; i++)
+        if (data[i] == x) return i;
+    return size;
+}
+
+// Counts matches without leaving the vector unit: a matching lane is all
+// ones, i.e. -1 in each of its bytes, so subtracting the compare result
+// adds one per byte to per-byte counters. Those are folded into a total
+// before they can wrap, and every match counts sizeof(T) bytes.
+template <typename T>
+size_t _simd_count(const T* data, size_t size, T x) {
+    using Eq = _simd_eq<T>;
+    constexpr size_t kLanes = _simd::kBytes / sizeof(T);
+    const _simd::reg needle = Eq::Splat(x);
+    uint64_t bytes = 0;
+    size_t i = 0;
+    while (i + kLanes <= size) {
+        size_t blocks = std::min<size_t>(255, (size - i) / kLanes);
+        _simd::reg acc = _simd::Zero();
+        for (size_t k = 0; k < blocks; k++, i += kLanes)
+            acc = _simd::SubBytes(acc, Eq::Eq(_simd::Load(data + i), needle));
+        bytes += _simd::SumBytes(acc);
+    }
+    size_t count = bytes / sizeof(T);
+    for (; i < size; i++) count += data[i] == x;
+    return count;
+}
+
+#endif
+
+// The index of the first element of data[0, size) equal to x, or size
+// if there is none.
+template <typename T>
+inline size_t FindFirst(const T* data, size_t size, const T& x) {
+#if defined(UTILS_SIMD_AVX2) || defined(UTILS_SIMD_SSE2)
+    if constexpr (_simd_searchable<T>) return _simd_find_first<T>(data, size, x);
+#endif
+    return std::find(data, data + size, x) - data;
+}
+
+// The number of elements of data[0, size) equal to x.
+template <typename T>
+inline size_t CountEqual(const T* data, size_t size, const T& x) {
+#if defined(UTILS_SIMD_AVX2) || defined(UTILS_SIMD_SSE2)
+    if constexpr (_simd_searchable<T>) return _simd_count<T>(data, size, x);
+#endif
+    return std::count(data, data + size, x);
+}
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_VECSEARCH_H__
@@ -0,0 +1,137 @@
+/**
+ * cpputil
+ *
+ * Watchdog for rate-controlled loops.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#include "watchdog.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+using Ticks = std::chrono::high_resolution_clock::duration;
+
+int64_t NowTicks() { return Utils::Now().time_since_epoch().count(); }
+
+// The monitor never sleeps longer than this, so a virtual clock that
+// jumps ahead is noticed in reasonable time.
+constexpr std::chrono::milliseconds kMaxPoll(100);
+
+}  // namespace
+
+Utils::Watchdog::Watchdog(MissCallback on_miss) : on_miss_(std::move(on_miss)) {
+    if (!on_miss_) {
+        on_miss_ = [](const Miss& m) {
+            LogFmt("watchdog: %s silent for %.3f s (timeout %.3f s, miss %llu)",
+                   m.name, m.silent, m.timeout, (unsigned long long)m.misses);
+        };
+    }
+}
+
+Utils::Watchdog::~Watchdog() { Stop(); }
+
+/**
+ * @brief Registers a loop with the watchdog.
+ *
+ * @param name A name used when reporting misses.
+ * @param period The expected time between beats.
+ * @param tolerance How many periods may pass without a beat before the
+ * loop is reported.
+ *
+ * @return The heartbeat the loop should beat once per iteration.
+ */
+Utils::Heartbeat* Utils::Watchdog::Register(const std::string& name,
+                                            std::chrono::nanoseconds period,
+                                            double tolerance) {
+    auto hb = std::make_unique<Heartbeat>();
+    hb->name_ = name;
+    hb->timeout_ = std::max<int64_t>(
+        1, std::chrono::duration_cast<Ticks>(period * tolerance).count());
+    hb->Beat();
+
+    Heartbeat* raw = hb.get();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        hb->id_ = next_id_++;
+        checks_.Push(Check{hb->last_.load(std::memory_order_relaxed) + hb->timeout_,
+                           hb->id_});
+        heartbeats_.emplace(hb->id_, std::move(hb));
+    }
+    cv_.notify_one();
+    return raw;
+}
+
+void Utils::Watchdog::Unregister(Heartbeat* heartbeat) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Stale entries in checks_ are skipped once the id is gone.
+    heartbeats_.erase(heartbeat->id_);
+}
+
+void Utils::Watchdog::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) return;
+    running_ = true;
+    thread_ = std::thread(&Watchdog::MonitorLoop, this);
+}
+
+void Utils::Watchdog::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+/**
+ * @brief The monitor thread. Pops the loops whose deadline has come,
+ * reports the silent ones and schedules their next check.
+ */
+void Utils::Watchdog::MonitorLoop() {
+    std::vector<Miss> pending;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        int64_t now = NowTicks();
+        if (checks_.Empty() || checks_.Top().due > now) {
+            auto wait = kMaxPoll;
+            if (!checks_.Empty())
+                wait = std::min(wait, std::chrono::duration_cast<std::chrono::milliseconds>(
+                                          Ticks(checks_.Top().due - now)) +
+                                          std::chrono::milliseconds(1));
+            cv_.wait_for(lock, wait);
+            continue;
+        }
+
+        Check check = checks_.Pop();
+        auto it = heartbeats_.find(check.id);
+        if (it == heartbeats_.end()) continue;
+        Heartbeat& hb = *it->second;
+
+        int64_t last = hb.last_.load(std::memory_order_relaxed);
+        if (now - last >= hb.timeout_) {
+            if (hb.reported_ != last) {
+                hb.reported_ = last;
+                hb.misses_++;
+                total_misses_.fetch_add(1, std::memory_order_relaxed);
+                pending.push_back(Miss{hb.name_,
+                                       std::chrono::duration<double>(Ticks(now - last)).count(),
+                                       std::chrono::duration<double>(Ticks(hb.timeout_)).count(),
+                                       hb.misses_});
+            }
+            checks_.Push(Check{now + hb.timeout_, check.id});
+        } else {
+            checks_.Push(Check{last + hb.timeout_, check.id});
+        }
+
+        if (!pending.empty()) {
+            lock.unlock();
+            for (const auto& m : pending) on_miss_(m);
+            pending.clear();
+            lock.lock();
+        }
+    }
+}
@@ -0,0 +1,112 @@
+/**
+ * cpputil
+ *
+ * Watchdog for rate-controlled loops. Each loop publishes a
+ * heartbeat once per iteration; a single monitor thread checks
+ * every registered loop against its expected period and reports
+ * the ones that stopped beating.
+ *
+ * Justus Languell     https://www.linkedin.com/in/justusl/
+ * Paul Ryan Bailey    https://www.linkedin.com/in/paul-ryan-bailey/
+ */
+#ifndef __UTILCPP_WATCHDOG_H__
+#define __UTILCPP_WATCHDOG_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "edf.h"
+#include "utils.h"
+
+namespace Utils {
+
+class Watchdog;
+
+// The loop side of the watchdog. Beat() is a single relaxed store, so it
+// can go in the hottest loop. Each heartbeat sits on its own cache line.
+class alignas(64) Heartbeat {
+   public:
+    void Beat() {
+        last_.store(Now().time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    const std::string& Name() const { return name_; }
+
+   private:
+    friend class Watchdog;
+
+    std::atomic<int64_t> last_{0};  // high_resolution_clock ticks
+    uint64_t id_ = 0;
+    std::string name_;
+    int64_t timeout_ = 0;           // ticks without a beat that count as a miss
+    int64_t reported_ = INT64_MIN;  // last_ value already reported as missed
+    uint64_t misses_ = 0;
+};
+
+// Monitors registered heartbeats from one background thread. Deadlines
+// are kept in a heap so each check only looks at loops that are due.
+// A loop that stays silent is reported once per stall, and again only
+// after it has beaten and stalled a second time.
+class Watchdog {
+   public:
+    struct Miss {
+        std::string name;
+        double silent;     // seconds since the last beat
+        double timeout;    // seconds allowed between beats
+        uint64_t misses;   // misses reported for this loop so far
+    };
+    using MissCallback = std::function<void(const Miss&)>;
+
+    // The callback runs on the monitor thread, without the watchdog lock
+    // held, so it may dump a flight recorder or take other slow action.
+    // Without a callback misses are logged with LogFmt.
+    explicit Watchdog(MissCallback on_miss = nullptr);
+    ~Watchdog();
+
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator=(const Watchdog&) = delete;
+
+    // Registers a loop that is expected to beat once per period. It is
+    // reported when tolerance periods pass without a beat. The returned
+    // heartbeat stays valid until it is unregistered or the watchdog is
+    // destroyed. Registration counts as the first beat.
+    Heartbeat* Register(const std::string& name, std::chrono::nanoseconds period,
+                        double tolerance = 2.0);
+    void Unregister(Heartbeat* heartbeat);
+
+    void Start();
+    void Stop();
+
+    uint64_t TotalMisses() const { return total_misses_.load(std::memory_order_relaxed); }
+
+   private:
+    struct Check {
+        int64_t due;  // high_resolution_clock ticks
+        uint64_t id;
+        bool operator<(const Check& o) const { return due < o.due; }
+    };
+
+    void MonitorLoop();
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::map<uint64_t, std::unique_ptr<Heartbeat>> heartbeats_;
+    DaryHeap<Check> checks_;
+    uint64_t next_id_ = 1;
+    MissCallback on_miss_;
+    std::thread thread_;
+    bool running_ = false;
+    std::atomic<uint64_t> total_misses_{0};
+};
+
+};  // namespace Utils
+
+#endif  // __UTILCPP_WATCHDOG_H__